@@ -0,0 +1,932 @@
+/*
+ *
+ * batch.c
+ *
+ * Created at:  10/18/2026 08:34:02 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The batch mode: evaluates the program over many input rows at once.
+ *
+ * Every element of the stack (and every variable) is a whole column, that is
+ * the values of all the rows. LOAD_NAME finds the input column of that name
+ * (and LOAD_LOCAL the column stored in that slot of the main block, which is
+ * the only block there is), LOAD_CONST fills a column with the constant and
+ * the binary ops go over the columns, so every instruction is decoded once per
+ * batch instead of once per row. Vectorizable native functions are called once
+ * with all the rows of their arguments, the scalar ones once per row.
+ *
+ * Columns are reference counted, so DUP, LOAD_NAME and STORE share them, and
+ * an op only writes over a column that nothing else uses.
+ *
+ * The rows are gone through NVM_BATCH_CHUNK at a time, so the columns stay in
+ * the cache, and the binary ops are done with the SIMD kernels the CPU
+ * supports (see `pick_kernels`).
+ *
+ * Only straight-line code is supported: no blocks and no calls to functions
+ * defined in the bytecode.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvm.h"
+
+#if NVM_SIMD && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86 1
+#include <immintrin.h>
+#else
+#define BATCH_X86 0
+#endif
+
+/*
+ * A column of values.
+ */
+typedef struct _column {
+  /* <rows> values */
+  INT *values;
+  /* number of references from the stack and the variables */
+  unsigned refs;
+  /* whether the values belong to the caller (so they're read only) */
+  bool external;
+  /* next column on the free list */
+  struct _column *next;
+} column_t;
+
+/*
+ * A variable, in the batch mode.
+ */
+typedef struct {
+  /* the name, straight from the bytecode or the inputs */
+  const char *name;
+  BYTE length;
+  column_t *column;
+} variable_t;
+
+/*
+ * The state of the batch.
+ */
+typedef struct {
+  nvm_t *vm;
+  /* rows in the current chunk */
+  size_t rows;
+  /* rows every column can hold */
+  size_t capacity;
+  /* the stack of columns */
+  column_t **stack;
+  size_t stack_count;
+  size_t stack_size;
+  /* the variables */
+  variable_t *vars;
+  size_t vars_count;
+  size_t vars_size;
+  /* the variables of the main blocks slots (indices into the variables) */
+  size_t *slots;
+  size_t slots_count;
+  size_t slots_size;
+  /* columns that are free to be reused */
+  column_t *free;
+  /* every column that was allocated */
+  column_t **all;
+  size_t all_count;
+  size_t all_size;
+} batch_t;
+
+/* {{{ columns */
+/*
+ * name:        grow
+ * description: makes sure the array of <size> elements of <elem> bytes can hold
+ *              one more
+ */
+static void *grow(batch_t *b, void *array, size_t count, size_t *size, size_t elem)
+{
+  if (count < *size)
+    return array;
+
+  size_t new_size = *size ? *size * 2 : 16;
+  void *new = nvm_alloc(b->vm, new_size * elem);
+  if (array){
+    memcpy(new, array, count * elem);
+    b->vm->freeer(array);
+  }
+  *size = new_size;
+
+  return new;
+}
+
+/*
+ * name:        new_column
+ * description: returns a column (with one reference) the caller can write to
+ */
+static column_t *new_column(batch_t *b)
+{
+  column_t *col = b->free;
+
+  if (col){
+    b->free = col->next;
+  } else {
+    col = nvm_alloc(b->vm, sizeof(column_t));
+    col->values = nvm_alloc(b->vm, b->capacity * sizeof(INT));
+    b->all = grow(b, b->all, b->all_count, &b->all_size, sizeof(column_t *));
+    b->all[b->all_count++] = col;
+  }
+
+  col->refs = 1;
+  col->external = false;
+  col->next = NULL;
+
+  return col;
+}
+
+/*
+ * name:        release
+ * description: drops a reference to the column
+ */
+static void release(batch_t *b, column_t *col)
+{
+  if (--col->refs)
+    return;
+
+  /* the inputs are just forgotten */
+  if (col->external){
+    b->vm->freeer(col);
+    return;
+  }
+
+  col->next = b->free;
+  b->free = col;
+}
+
+/*
+ * name:        writable
+ * description: whether an op can write its result over the column
+ */
+static inline bool writable(const column_t *col)
+{
+  return col->refs == 1 && !col->external;
+}
+/* }}} */
+
+/* {{{ kernels */
+/*
+ * A kernel does one binary op over <rows> rows: z = x op y. <z> may be the
+ * same array as <x>. The columns only hold INTEGERs, so a result that doesn't
+ * fit in one (which the interpreter would make a LONG) is an error, instead of
+ * wrapping around. Returns 0, -1 on a division by zero, or -2 on an overflow
+ * (what's in <z> then is garbage).
+ */
+typedef int (*kernel_t)(INT *z, const INT *x, const INT *y, size_t rows);
+
+typedef struct {
+  const char *name;
+  kernel_t add, sub, mul, div;
+} kernels_t;
+
+static int scalar_add(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  bool overflow = false;
+  for (size_t i = 0; i < rows; i++)
+    overflow |= __builtin_add_overflow(x[i], y[i], &z[i]);
+  return overflow ? -2 : 0;
+}
+
+static int scalar_sub(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  bool overflow = false;
+  for (size_t i = 0; i < rows; i++)
+    overflow |= __builtin_sub_overflow(x[i], y[i], &z[i]);
+  return overflow ? -2 : 0;
+}
+
+static int scalar_mul(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  bool overflow = false;
+  for (size_t i = 0; i < rows; i++)
+    overflow |= __builtin_mul_overflow(x[i], y[i], &z[i]);
+  return overflow ? -2 : 0;
+}
+
+static int scalar_div(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  for (size_t i = 0; i < rows; i++){
+    if (y[i] == 0)
+      return -1;
+    if (x[i] == INT32_MIN && y[i] == -1)
+      return -2;
+    z[i] = x[i] / y[i];
+  }
+  return 0;
+}
+
+#if BATCH_X86
+/*
+ * The sums and the differences overflowed when their sign is wrong: a sum
+ * can't have a sign neither operand has, and a difference of the operands of
+ * different signs has to have the sign of the first one. The products are
+ * done in 64 bits (the even and the odd lanes apart), and they overflowed
+ * when their upper half isn't just the sign of the lower one. The overflows
+ * are gathered over the whole column, and only looked at in the end.
+ *
+ * There's no integer division in SSE/AVX, so it's done in doubles, which is
+ * exact for 32-bit operands. The vectors with a zero divisor (or INT_MIN / -1)
+ * are left to `scalar_div`.
+ */
+
+/* {{{ SSE2 */
+__attribute__((target("sse2")))
+static int sse2_add(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  __m128i overflow = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= rows; i += 4){
+    __m128i a = _mm_loadu_si128((const __m128i *)&x[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&y[i]);
+    __m128i r = _mm_add_epi32(a, b);
+    overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(r, a), _mm_xor_si128(r, b)));
+    _mm_storeu_si128((__m128i *)&z[i], r);
+  }
+  if (_mm_movemask_ps(_mm_castsi128_ps(overflow)))
+    return -2;
+  return scalar_add(&z[i], &x[i], &y[i], rows - i);
+}
+
+__attribute__((target("sse2")))
+static int sse2_sub(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  __m128i overflow = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= rows; i += 4){
+    __m128i a = _mm_loadu_si128((const __m128i *)&x[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&y[i]);
+    __m128i r = _mm_sub_epi32(a, b);
+    overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(a, b), _mm_xor_si128(r, a)));
+    _mm_storeu_si128((__m128i *)&z[i], r);
+  }
+  if (_mm_movemask_ps(_mm_castsi128_ps(overflow)))
+    return -2;
+  return scalar_sub(&z[i], &x[i], &y[i], rows - i);
+}
+
+__attribute__((target("sse2")))
+static int sse2_div(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i minus_one = _mm_set1_epi32(-1);
+  const __m128i min = _mm_set1_epi32(INT32_MIN);
+  size_t i = 0;
+
+  for (; i + 4 <= rows; i += 4){
+    __m128i a = _mm_loadu_si128((const __m128i *)&x[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&y[i]);
+    __m128i bad = _mm_or_si128(_mm_cmpeq_epi32(b, zero),
+                  _mm_and_si128(_mm_cmpeq_epi32(a, min), _mm_cmpeq_epi32(b, minus_one)));
+
+    if (_mm_movemask_epi8(bad)){
+      int failed = scalar_div(&z[i], &x[i], &y[i], 4);
+      if (failed)
+        return failed;
+      continue;
+    }
+
+    /* two at a time, the lower and the upper half */
+    __m128i lo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(b)));
+    __m128i hi = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(a, 8)),
+                                             _mm_cvtepi32_pd(_mm_srli_si128(b, 8))));
+    _mm_storeu_si128((__m128i *)&z[i], _mm_unpacklo_epi64(lo, hi));
+  }
+  return scalar_div(&z[i], &x[i], &y[i], rows - i);
+}
+/* }}} */
+
+/* {{{ SSE4.1 */
+__attribute__((target("sse4.1")))
+static int sse41_mul(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  /* the upper halves of the 64-bit products */
+  const __m128i upper = _mm_set_epi32(-1, 0, -1, 0);
+  __m128i overflow = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= rows; i += 4){
+    __m128i a = _mm_loadu_si128((const __m128i *)&x[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&y[i]);
+    __m128i even = _mm_mul_epi32(a, b);
+    __m128i odd = _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    /* the sign of the lower half, where the upper one is */
+    __m128i even_sign = _mm_shuffle_epi32(_mm_srai_epi32(even, 31), _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i odd_sign = _mm_shuffle_epi32(_mm_srai_epi32(odd, 31), _MM_SHUFFLE(2, 2, 0, 0));
+    overflow = _mm_or_si128(overflow, _mm_or_si128(_mm_xor_si128(even, even_sign), _mm_xor_si128(odd, odd_sign)));
+    _mm_storeu_si128((__m128i *)&z[i], _mm_mullo_epi32(a, b));
+  }
+  if (!_mm_testz_si128(overflow, upper))
+    return -2;
+  return scalar_mul(&z[i], &x[i], &y[i], rows - i);
+}
+/* }}} */
+
+/* {{{ AVX2 */
+__attribute__((target("avx2")))
+static int avx2_add(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  __m256i overflow = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= rows; i += 8){
+    __m256i a = _mm256_loadu_si256((const __m256i *)&x[i]);
+    __m256i b = _mm256_loadu_si256((const __m256i *)&y[i]);
+    __m256i r = _mm256_add_epi32(a, b);
+    overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(r, a), _mm256_xor_si256(r, b)));
+    _mm256_storeu_si256((__m256i *)&z[i], r);
+  }
+  if (_mm256_movemask_ps(_mm256_castsi256_ps(overflow)))
+    return -2;
+  return sse2_add(&z[i], &x[i], &y[i], rows - i);
+}
+
+__attribute__((target("avx2")))
+static int avx2_sub(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  __m256i overflow = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= rows; i += 8){
+    __m256i a = _mm256_loadu_si256((const __m256i *)&x[i]);
+    __m256i b = _mm256_loadu_si256((const __m256i *)&y[i]);
+    __m256i r = _mm256_sub_epi32(a, b);
+    overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(r, a)));
+    _mm256_storeu_si256((__m256i *)&z[i], r);
+  }
+  if (_mm256_movemask_ps(_mm256_castsi256_ps(overflow)))
+    return -2;
+  return sse2_sub(&z[i], &x[i], &y[i], rows - i);
+}
+
+__attribute__((target("avx2")))
+static int avx2_mul(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  const __m256i upper = _mm256_set_epi32(-1, 0, -1, 0, -1, 0, -1, 0);
+  __m256i overflow = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= rows; i += 8){
+    __m256i a = _mm256_loadu_si256((const __m256i *)&x[i]);
+    __m256i b = _mm256_loadu_si256((const __m256i *)&y[i]);
+    __m256i even = _mm256_mul_epi32(a, b);
+    __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    __m256i even_sign = _mm256_shuffle_epi32(_mm256_srai_epi32(even, 31), _MM_SHUFFLE(2, 2, 0, 0));
+    __m256i odd_sign = _mm256_shuffle_epi32(_mm256_srai_epi32(odd, 31), _MM_SHUFFLE(2, 2, 0, 0));
+    overflow = _mm256_or_si256(overflow, _mm256_or_si256(_mm256_xor_si256(even, even_sign), _mm256_xor_si256(odd, odd_sign)));
+    _mm256_storeu_si256((__m256i *)&z[i], _mm256_mullo_epi32(a, b));
+  }
+  if (!_mm256_testz_si256(overflow, upper))
+    return -2;
+  return sse41_mul(&z[i], &x[i], &y[i], rows - i);
+}
+
+__attribute__((target("avx2")))
+static int avx2_div(INT *z, const INT *x, const INT *y, size_t rows)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i minus_one = _mm_set1_epi32(-1);
+  const __m128i min = _mm_set1_epi32(INT32_MIN);
+  size_t i = 0;
+
+  for (; i + 4 <= rows; i += 4){
+    __m128i a = _mm_loadu_si128((const __m128i *)&x[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&y[i]);
+    __m128i bad = _mm_or_si128(_mm_cmpeq_epi32(b, zero),
+                  _mm_and_si128(_mm_cmpeq_epi32(a, min), _mm_cmpeq_epi32(b, minus_one)));
+
+    if (_mm_movemask_epi8(bad)){
+      int failed = scalar_div(&z[i], &x[i], &y[i], 4);
+      if (failed)
+        return failed;
+      continue;
+    }
+
+    __m256d q = _mm256_div_pd(_mm256_cvtepi32_pd(a), _mm256_cvtepi32_pd(b));
+    _mm_storeu_si128((__m128i *)&z[i], _mm256_cvttpd_epi32(q));
+  }
+  return scalar_div(&z[i], &x[i], &y[i], rows - i);
+}
+/* }}} */
+#endif /* BATCH_X86 */
+
+static const kernels_t all_kernels[] = {
+#if BATCH_X86
+  { "avx2",   avx2_add, avx2_sub, avx2_mul,   avx2_div },
+  { "sse4.1", sse2_add, sse2_sub, sse41_mul,  sse2_div },
+  { "sse2",   sse2_add, sse2_sub, scalar_mul, sse2_div },
+#endif
+  { "scalar", scalar_add, scalar_sub, scalar_mul, scalar_div },
+};
+
+#define KERNELS_COUNT (sizeof(all_kernels) / sizeof(all_kernels[0]))
+
+/* the ones in use, picked on the first batch */
+static const kernels_t *kernels = NULL;
+
+/*
+ * name:        supported
+ * description: whether the CPU can run the kernels
+ */
+static bool supported(const kernels_t *k)
+{
+#if BATCH_X86
+  __builtin_cpu_init();
+  if (!strcmp(k->name, "avx2"))
+    return __builtin_cpu_supports("avx2");
+  if (!strcmp(k->name, "sse4.1"))
+    return __builtin_cpu_supports("sse4.1");
+  if (!strcmp(k->name, "sse2"))
+    return __builtin_cpu_supports("sse2");
+#endif
+  (void)k;
+  return true;
+}
+
+/*
+ * name:        pick_kernels
+ * description: returns the best kernels the CPU supports (the list is from the
+ *              best to the worst, and the scalar ones always are)
+ */
+static const kernels_t *pick_kernels(void)
+{
+  if (!kernels){
+    for (size_t i = 0; i < KERNELS_COUNT; i++){
+      if (supported(&all_kernels[i])){
+        kernels = &all_kernels[i];
+        break;
+      }
+    }
+  }
+
+  return kernels;
+}
+
+const char *nvm_batch_kernels(void)
+{
+  return pick_kernels()->name;
+}
+
+int nvm_use_batch_kernels(const char *name)
+{
+  for (size_t i = 0; i < KERNELS_COUNT; i++){
+    if (!strcmp(all_kernels[i].name, name)){
+      if (!supported(&all_kernels[i]))
+        return -1;
+      kernels = &all_kernels[i];
+      return 0;
+    }
+  }
+
+  return -1;
+}
+/* }}} */
+
+/* {{{ the stack */
+static void push(batch_t *b, column_t *col)
+{
+  b->stack = grow(b, b->stack, b->stack_count, &b->stack_size, sizeof(column_t *));
+  b->stack[b->stack_count++] = col;
+}
+
+static bool need(batch_t *b, size_t count, const char *what)
+{
+  if (b->stack_count < count){
+    fprintf(stderr, "nvm: error: attempting to %s on a stack of %lu elements\n", what, b->stack_count);
+    return false;
+  }
+  return true;
+}
+/* }}} */
+
+/* {{{ variables */
+static variable_t *find_var(batch_t *b, const char *name, BYTE length)
+{
+  for (size_t i = 0; i < b->vars_count; i++)
+    if (b->vars[i].length == length && !memcmp(b->vars[i].name, name, length))
+      return &b->vars[i];
+
+  return NULL;
+}
+
+/*
+ * name:        store_var
+ * description: makes <col> the value of the variable of that name (defining
+ *              it, if there's none)
+ * return:      index of the variable
+ */
+static size_t store_var(batch_t *b, const char *name, BYTE length, column_t *col)
+{
+  variable_t *var = find_var(b, name, length);
+
+  if (var){
+    release(b, var->column);
+  } else {
+    b->vars = grow(b, b->vars, b->vars_count, &b->vars_size, sizeof(variable_t));
+    var = &b->vars[b->vars_count++];
+    var->name = name;
+    var->length = length;
+  }
+
+  var->column = col;
+
+  return var - b->vars;
+}
+
+/*
+ * name:        store_slot
+ * description: makes <col> the value of the variable in the <slot> of the
+ *              main block, the next slot defines it (as <name>)
+ */
+static bool store_slot(batch_t *b, BYTE slot, const char *name, BYTE length, column_t *col)
+{
+  if (slot < b->slots_count){
+    release(b, b->vars[b->slots[slot]].column);
+    b->vars[b->slots[slot]].column = col;
+    return true;
+  }
+  if (slot > b->slots_count){
+    fprintf(stderr, "nvm: error: storing to the undefined slot %u\n", slot);
+    return false;
+  }
+
+  b->slots = grow(b, b->slots, b->slots_count, &b->slots_size, sizeof(size_t));
+  b->slots[b->slots_count++] = store_var(b, name, length, col);
+  return true;
+}
+/* }}} */
+
+/*
+ * name:        find_func
+ * description: returns the native function of that name (or NULL)
+ */
+static nvm_func *find_func(nvm_t *vm, const char *name, BYTE length)
+{
+  for (nvm_funcs_stack *p = vm->funcs; p != NULL; p = p->next)
+    if (!strncmp(p->func->name, name, length) && p->func->name[length] == '\0')
+      return p->func;
+
+  return NULL;
+}
+
+/*
+ * name:        call_vector
+ * description: calls the vectorizable native function once for all the rows
+ */
+static int call_vector(batch_t *b, nvm_func *func)
+{
+  /* {{{ call_vector body */
+  column_t **args = &b->stack[b->stack_count - func->arity];
+  const INT *argv[func->arity ? func->arity : 1];
+  column_t *result;
+  int results;
+
+  for (unsigned k = 0; k < func->arity; k++)
+    argv[k] = args[k]->values;
+
+  /* write over the first argument if nothing else needs it */
+  if (func->arity && writable(args[0])){
+    result = args[0];
+    result->refs++;
+  } else {
+    result = new_column(b);
+  }
+
+  results = func->vector(b->vm, argv, func->arity, result->values, b->rows);
+
+  for (unsigned k = 0; k < func->arity; k++)
+    release(b, args[k]);
+  b->stack_count -= func->arity;
+
+  if (results < 0 || results > 1){
+    release(b, result);
+    fprintf(stderr, "nvm: error: native function '%s' failed\n", func->name);
+    return -1;
+  }
+
+  if (results)
+    push(b, result);
+  else
+    release(b, result);
+
+  return 0;
+  /* }}} */
+}
+
+/*
+ * name:        call_scalar
+ * description: calls the native function once per row
+ */
+static int call_scalar(batch_t *b, nvm_func *func)
+{
+  /* {{{ call_scalar body */
+  column_t **args = &b->stack[b->stack_count - func->arity];
+  nvm_value values[func->arity + NVM_NATIVE_MAX_RESULTS];
+  column_t *results[func->arity + NVM_NATIVE_MAX_RESULTS];
+  int count = -1;
+
+  for (size_t row = 0; row < b->rows; row++){
+    for (unsigned k = 0; k < func->arity; k++){
+      values[k].type = INTEGER;
+      values[k].as.i = args[k]->values[row];
+    }
+
+    int n = func->native(b->vm, values, func->arity);
+    /* every row has to give the same number of results, and they have to be
+     * INTEGERs (that's all the columns hold) */
+    bool failed = n < 0 || (unsigned)n > func->arity + NVM_NATIVE_MAX_RESULTS || (count >= 0 && n != count);
+
+    for (int r = 0; !failed && r < n; r++)
+      failed = values[r].type != INTEGER;
+
+    if (failed){
+      for (int r = 0; r < count; r++)
+        release(b, results[r]);
+      fprintf(stderr, "nvm: error: native function '%s' failed\n", func->name);
+      return -1;
+    }
+
+    if (count < 0){
+      count = n;
+      for (int r = 0; r < count; r++)
+        results[r] = new_column(b);
+    }
+
+    for (int r = 0; r < count; r++)
+      results[r]->values[row] = values[r].as.i;
+  }
+
+  for (unsigned k = 0; k < func->arity; k++)
+    release(b, args[k]);
+  b->stack_count -= func->arity;
+
+  for (int r = 0; r < count; r++)
+    push(b, results[r]);
+
+  return 0;
+  /* }}} */
+}
+
+/*
+ * name:        unquickened
+ * description: returns the generic op for the quickened one (the interpreter
+ *              may have quickened the bytecode already), the columns have
+ *              their own kernels
+ */
+static inline BYTE unquickened(BYTE op)
+{
+  switch (op){
+    case BINARY_ADD_INT:
+    case BINARY_ADD_DOUBLE:
+      return BINARY_ADD;
+    case BINARY_SUB_INT:
+    case BINARY_SUB_DOUBLE:
+      return BINARY_SUB;
+    case BINARY_MUL_INT:
+    case BINARY_MUL_DOUBLE:
+      return BINARY_MUL;
+    case BINARY_DIV_INT:
+    case BINARY_DIV_DOUBLE:
+      return BINARY_DIV;
+    default:
+      return op;
+  }
+}
+
+/*
+ * name:        execute
+ * description: runs the bytecode over the columns
+ */
+static int execute(batch_t *b)
+{
+  /* {{{ execute body */
+  nvm_t *vm = b->vm;
+  const BYTE *bytes = vm->bytes;
+  const kernels_t *k = pick_kernels();
+  size_t rows = b->rows;
+
+  for (off_t ip = 3; ip < vm->bytes_count; ip++){
+    BYTE op = unquickened(bytes[ip]);
+
+    switch (op){
+      case NOP:
+        break;
+      case LOAD_CONST: {
+        INT integer = bytes[ip + 1] ^ (bytes[ip + 2] << 8) ^ (bytes[ip + 3] << 16) ^ ((uint32_t)bytes[ip + 4] << 24);
+        column_t *col = new_column(b);
+        for (size_t row = 0; row < rows; row++)
+          col->values[row] = integer;
+        push(b, col);
+        ip += 4;
+        break;
+      }
+      case DISCARD:
+        if (!need(b, 1, "discard"))
+          return -3;
+        release(b, b->stack[--b->stack_count]);
+        break;
+      case ROT_TWO: {
+        if (!need(b, 2, "rot_two"))
+          return -3;
+        column_t **top = &b->stack[b->stack_count];
+        column_t *FOS = top[-1];
+        top[-1] = top[-2];
+        top[-2] = FOS;
+        break;
+      }
+      case ROT_THREE: {
+        if (!need(b, 3, "rot_three"))
+          return -3;
+        column_t **top = &b->stack[b->stack_count];
+        column_t *FOS = top[-1];
+        top[-1] = top[-2];
+        top[-2] = top[-3];
+        top[-3] = FOS;
+        break;
+      }
+      case DUP:
+        if (!need(b, 1, "dup"))
+          return -3;
+        b->stack[b->stack_count - 1]->refs++;
+        push(b, b->stack[b->stack_count - 1]);
+        break;
+      case STORE:
+        if (!need(b, 1, "store"))
+          return -3;
+        store_var(b, (const char *)&bytes[ip + 2], bytes[ip + 1], b->stack[--b->stack_count]);
+        ip += 1 + bytes[ip + 1];
+        break;
+      case LOAD_NAME: {
+        variable_t *var = find_var(b, (const char *)&bytes[ip + 2], bytes[ip + 1]);
+        if (!var){
+          fprintf(stderr, "nvm: variable '%.*s' not found\n", bytes[ip + 1], &bytes[ip + 2]);
+          return -2;
+        }
+        var->column->refs++;
+        push(b, var->column);
+        ip += 1 + bytes[ip + 1];
+        break;
+      }
+      case STORE_LOCAL:
+        if (!need(b, 1, "store"))
+          return -3;
+        if (bytes[ip + 1]){
+          fprintf(stderr, "nvm: error: there are no blocks in the batch mode\n");
+          return -1;
+        }
+        if (!store_slot(b, bytes[ip + 2], (const char *)&bytes[ip + 4], bytes[ip + 3], b->stack[--b->stack_count]))
+          return -1;
+        ip += 3 + bytes[ip + 3];
+        break;
+      case LOAD_LOCAL: {
+        if (bytes[ip + 1] || bytes[ip + 2] >= b->slots_count){
+          fprintf(stderr, "nvm: variable in the slot %u of the block %u blocks out not found\n", bytes[ip + 2], bytes[ip + 1]);
+          return -2;
+        }
+        variable_t *var = &b->vars[b->slots[bytes[ip + 2]]];
+        var->column->refs++;
+        push(b, var->column);
+        ip += 2;
+        break;
+      }
+      case BINARY_ADD:
+      case BINARY_SUB:
+      case BINARY_MUL:
+      case BINARY_DIV: {
+        if (!need(b, 2, "do a binary op"))
+          return -3;
+        column_t *FOS = b->stack[b->stack_count - 1];
+        column_t *SOS = b->stack[b->stack_count - 2];
+        column_t *res = writable(SOS) ? SOS : new_column(b);
+        kernel_t kernel = op == BINARY_ADD ? k->add :
+                          op == BINARY_SUB ? k->sub :
+                          op == BINARY_MUL ? k->mul : k->div;
+
+        int failed = kernel(res->values, SOS->values, FOS->values, rows);
+
+        release(b, FOS);
+        if (res != SOS)
+          release(b, SOS);
+        b->stack_count -= 2;
+        push(b, res);
+
+        if (failed){
+          if (failed == -2)
+            fprintf(stderr, "nvm: error: integer overflow in the batch mode (it only does INTEGERs)\n");
+          else
+            fprintf(stderr, "nvm: error: division by zero\n");
+          return -1;
+        }
+        break;
+      }
+      case FN_START:
+        /* skip over the whole definition (the name, the number of arguments
+         * and the body), nothing calls it here; the body is gone through
+         * instruction by instruction, the FN_END byte may be an argument too */
+        ip += 3 + bytes[ip + 1];
+        while (ip < vm->bytes_count && bytes[ip] != FN_END)
+          ip += nvm_insn_size(vm, ip);
+        break;
+      case CALL: {
+        nvm_func *func = find_func(vm, (const char *)&bytes[ip + 2], bytes[ip + 1]);
+        int status;
+
+        if (!func || (!func->native && !func->vector)){
+          fprintf(stderr, "nvm: error: function '%.*s' can't be called in the batch mode\n", bytes[ip + 1], &bytes[ip + 2]);
+          return -1;
+        }
+        if (!need(b, func->arity, "call a native function"))
+          return -3;
+
+        status = func->vector ? call_vector(b, func) : call_scalar(b, func);
+        if (status)
+          return status;
+
+        ip += 1 + bytes[ip + 1];
+        break;
+      }
+      default:
+        fprintf(stderr, "nvm: error: op 0x%02X at position 0x%02X isn't supported in the batch mode\n", op, (unsigned)ip);
+        return -1;
+    }
+  }
+
+  return 0;
+  /* }}} */
+}
+
+/*
+ * name:        clear
+ * description: drops the stack and the variables left by a chunk
+ */
+static void clear(batch_t *b)
+{
+  for (size_t i = 0; i < b->stack_count; i++)
+    release(b, b->stack[i]);
+  for (size_t i = 0; i < b->vars_count; i++)
+    release(b, b->vars[i].column);
+  b->stack_count = 0;
+  b->vars_count = 0;
+  b->slots_count = 0;
+}
+
+int nvm_run_batch(nvm_t *vm, const nvm_column *inputs, unsigned inputs_count, size_t rows, INT *output)
+{
+  /* {{{ nvm_run_batch body */
+  batch_t b;
+  int status = 0;
+
+  memset(&b, 0, sizeof(b));
+  b.vm = vm;
+  b.capacity = rows < NVM_BATCH_CHUNK ? rows : NVM_BATCH_CHUNK;
+
+  for (size_t start = 0; start < rows && !status; start += b.rows){
+    b.rows = rows - start < b.capacity ? rows - start : b.capacity;
+
+    /* bind the inputs */
+    for (unsigned i = 0; i < inputs_count; i++){
+      column_t *col = nvm_alloc(b.vm, sizeof(column_t));
+      col->values = (INT *)inputs[i].values + start;
+      col->refs = 1;
+      col->external = true;
+      col->next = NULL;
+      store_var(&b, inputs[i].name, strlen(inputs[i].name), col);
+    }
+
+    status = execute(&b);
+
+    /* the result is the FOS */
+    if (!status){
+      if (b.stack_count){
+        memcpy(output + start, b.stack[b.stack_count - 1]->values, b.rows * sizeof(INT));
+      } else {
+        fprintf(stderr, "nvm: error: the program left nothing on the stack\n");
+        status = -3;
+      }
+    }
+
+    clear(&b);
+  }
+
+  /* clean up */
+  for (size_t i = 0; i < b.all_count; i++){
+    vm->freeer(b.all[i]->values);
+    vm->freeer(b.all[i]);
+  }
+  if (b.all)
+    vm->freeer(b.all);
+  if (b.stack)
+    vm->freeer(b.stack);
+  if (b.vars)
+    vm->freeer(b.vars);
+  if (b.slots)
+    vm->freeer(b.slots);
+
+  return status;
+  /* }}} */
+}
@@ -0,0 +1,1352 @@
+/*
+ *
+ * bench.c
+ *
+ * Created at:  10/18/2026 06:03:11 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * Microbenchmarks for NVM.
+ *
+ * Every opcode benchmark runs two programs: one that repeats the setup and the
+ * measured instruction(s) <n> times, and a baseline that repeats just the
+ * setup. The difference, divided by <n>, is the cost of the instruction. Each
+ * measurement is repeated, and the median, mean, standard deviation, minimum
+ * and maximum of the ns/op are reported (and optionally written as JSON).
+ *
+ * Usage: nvm_bench [-n ops] [-r repetitions] [-f filter] [-j file.json]
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "nvm.h"
+#include "grammar.h"
+#include "bigint.h"
+#include "gc.h"
+#include "loop.h"
+#include "sched.h"
+#include "channel.h"
+
+/* Default number of times the measured instructions are repeated */
+#define DEFAULT_OPS 20000
+/* Default number of times every measurement is repeated */
+#define DEFAULT_REPETITIONS 11
+/* Maximum number of repetitions */
+#define MAX_REPETITIONS 1000
+
+/* the grammar writes the bytecode here */
+FILE *fp;
+
+typedef union {
+  int i;
+  char *s;
+} TokenType;
+
+/* Lemon stuff */
+void *ParseAlloc(void *(*)(size_t));
+void  Parse(void *, int, TokenType);
+void  ParseFree(void *, void (*)(void*));
+
+/*
+ * Bytecode that is being put together.
+ */
+typedef struct {
+  BYTE *bytes;
+  size_t count;
+  size_t size;
+} code_t;
+
+/*
+ * The results of a single benchmark.
+ */
+typedef struct {
+  const char *name;
+  /* what the `op` is */
+  const char *unit;
+  /* how many ops every measurement was made of */
+  unsigned long ops;
+  /* bytes of bytecode, where it matters */
+  unsigned long bytes;
+  /* ns/op of every repetition */
+  double samples[MAX_REPETITIONS];
+  unsigned count;
+} result_t;
+
+/* {{{ settings */
+static unsigned long ops = DEFAULT_OPS;
+static unsigned repetitions = DEFAULT_REPETITIONS;
+static const char *filter = NULL;
+static FILE *json = NULL;
+static unsigned results_count = 0;
+static char path[] = "/tmp/nvm-bench-XXXXXX";
+/* the fuel the programs run with, resumed a slice at a time (0 for no
+ * limit) */
+static uint64_t slice = 0;
+/* }}} */
+
+/*
+ * name:        now
+ * description: returns the monotonic time in nanoseconds
+ */
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* {{{ bytecode emitting */
+static void emit(code_t *code, const void *bytes, size_t count)
+{
+  if (code->count + count > code->size){
+    code->size = (code->count + count) * 2;
+    code->bytes = realloc(code->bytes, code->size);
+    if (!code->bytes){
+      fprintf(stderr, "nvm_bench: failed to allocate %lu bytes\n", code->size);
+      exit(1);
+    }
+  }
+  memcpy(code->bytes + code->count, bytes, count);
+  code->count += count;
+}
+
+static void emit_op(code_t *code, BYTE op)
+{
+  emit(code, &op, 1);
+}
+
+static void emit_const(code_t *code, INT value)
+{
+  BYTE bytes[5] = { LOAD_CONST, value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >> 24) & 0xff };
+  emit(code, bytes, sizeof(bytes));
+}
+
+static void emit_long(code_t *code, int64_t value)
+{
+  BYTE bytes[9] = { LOAD_CONST_LONG };
+  for (int i = 0; i < 8; i++)
+    bytes[1 + i] = ((uint64_t)value >> (8 * i)) & 0xff;
+  emit(code, bytes, sizeof(bytes));
+}
+
+static void emit_double(code_t *code, double value)
+{
+  int64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  emit_long(code, bits);
+  /* the same bytes, only the opcode differs */
+  code->bytes[code->count - 9] = LOAD_CONST_DOUBLE;
+}
+
+static void emit_string(code_t *code, const char *string)
+{
+  uint32_t length = strlen(string);
+  BYTE bytes[5] = { LOAD_CONST_STRING, length & 0xff, (length >> 8) & 0xff, (length >> 16) & 0xff, (length >> 24) & 0xff };
+  emit(code, bytes, sizeof(bytes));
+  emit(code, string, length);
+}
+
+static void emit_name(code_t *code, BYTE op, const char *name)
+{
+  BYTE length = strlen(name);
+  emit_op(code, op);
+  emit(code, &length, 1);
+  emit(code, name, length);
+}
+
+static void emit_slot(code_t *code, BYTE op, BYTE depth, BYTE slot, const char *name)
+{
+  BYTE bytes[3] = { op, depth, slot };
+  emit(code, bytes, sizeof(bytes));
+  if (name){
+    BYTE length = strlen(name);
+    emit(code, &length, 1);
+    emit(code, name, length);
+  }
+}
+
+static void emit_fn(code_t *code, const char *name, BYTE arity)
+{
+  emit_name(code, FN_START, name);
+  emit(code, &arity, 1);
+}
+
+static void emit_version(code_t *code)
+{
+  BYTE version[3] = { NVM_VERSION_MAJOR, NVM_VERSION_MINOR, NVM_VERSION_PATCH };
+  code->count = 0;
+  emit(code, version, sizeof(version));
+}
+/* }}} */
+
+/*
+ * name:        write_code
+ * description: writes the bytecode to the scratch file
+ */
+static void write_code(const code_t *code)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f || fwrite(code->bytes, 1, code->count, f) != code->count){
+    fprintf(stderr, "nvm_bench: couldn't write %s\n", path);
+    exit(1);
+  }
+  fclose(f);
+}
+
+/*
+ * name:        native_add
+ * description: a host function for the calls benchmarks
+ */
+static int native_add(nvm_t *vm, nvm_value *args, unsigned argc)
+{
+  (void)vm;
+  (void)argc;
+  args[0].as.i += args[1].as.i;
+  return 1;
+}
+
+/* the channel the bytecode gets from `native_channel` */
+static nvm_channel *channel;
+
+/*
+ * name:        native_channel
+ * description: a host function handing the channel over, for the channels
+ *              benchmarks
+ */
+static int native_channel(nvm_t *vm, nvm_value *args, unsigned argc)
+{
+  (void)vm;
+  (void)argc;
+  nvm_channel_value(&args[0], channel);
+  return 1;
+}
+
+/*
+ * name:        vector_score
+ * description: a vectorizable host function for the batch benchmarks
+ */
+static int vector_score(nvm_t *vm, const INT *const *args, unsigned argc, INT *result, size_t rows)
+{
+  (void)vm;
+  (void)argc;
+  for (size_t row = 0; row < rows; row++)
+    result[row] = args[0][row] * 3 + args[1][row];
+  return 1;
+}
+
+/*
+ * name:        native_score
+ * description: the same as `vector_score`, but one row at a time
+ */
+static int native_score(nvm_t *vm, nvm_value *args, unsigned argc)
+{
+  (void)vm;
+  (void)argc;
+  args[0].as.i = args[0].as.i * 3 + args[1].as.i;
+  return 1;
+}
+
+/* {{{ the fake I/O service of the async benchmarks */
+static nvm_loop *loop;
+/* what the VMs on the loop ended up with */
+static long long async_sum;
+
+/*
+ * name:        fetched
+ * description: reads the answer the `native_fetch` waited for
+ */
+static int fetched(nvm_t *vm, nvm_value *args, unsigned argc, int fd, void *data)
+{
+  INT answer;
+
+  (void)vm;
+  (void)argc;
+  (void)data;
+  if (read(fd, &answer, sizeof(answer)) != sizeof(answer))
+    return -1;
+  close(fd);
+
+  args[0].type = INTEGER;
+  args[0].as.i = answer;
+  return 1;
+}
+
+/*
+ * name:        native_fetch
+ * description: a host function that asks the "service" for twice its
+ *              argument, and waits for the answer (that's already there, the
+ *              service being a pipe, but it comes through the loop all the
+ *              same)
+ */
+static int native_fetch(nvm_t *vm, nvm_value *args, unsigned argc)
+{
+  INT answer = args[0].as.i * 2;
+  int fds[2];
+
+  (void)argc;
+  if (pipe(fds) < 0)
+    return -1;
+  if (write(fds[1], &answer, sizeof(answer)) != sizeof(answer))
+    return -1;
+  close(fds[1]);
+
+  if (nvm_loop_await(loop, vm, fds[0], EPOLLIN, fetched, NULL) < 0)
+    return -1;
+  return NVM_AWAIT;
+}
+
+static void finished(nvm_t *vm, int status, void *data)
+{
+  (void)data;
+  if (status == NVM_DONE)
+    async_sum += vm->stack->top[-1].as.i;
+}
+/* }}} */
+
+/*
+ * name:        run_code
+ * description: loads the bytecode and returns how long executing it took
+ */
+static double run_code(const code_t *code)
+{
+  write_code(code);
+
+  nvm_t *vm = nvm_init(path, NULL, NULL);
+  if (!vm || nvm_validate(vm) != 0){
+    fprintf(stderr, "nvm_bench: invalid benchmark bytecode\n");
+    exit(1);
+  }
+  nvm_register_native(vm, "add", native_add, 2);
+  nvm_register_native(vm, "chan", native_channel, 0);
+
+  double start = now();
+  if (slice){
+    nvm_set_fuel(vm, slice);
+    for (int status = nvm_blastoff(vm); status == NVM_OUT_OF_FUEL; status = nvm_resume(vm))
+      nvm_set_fuel(vm, slice);
+  } else {
+    nvm_blastoff(vm);
+  }
+  double elapsed = now() - start;
+
+  nvm_destroy(vm);
+
+  return elapsed;
+}
+
+/* {{{ results */
+static int compare(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static bool wanted(const char *name)
+{
+  return !filter || strstr(name, filter);
+}
+
+static void report(result_t *res)
+{
+  double sum = 0, var = 0, mean, median;
+
+  qsort(res->samples, res->count, sizeof(double), compare);
+
+  for (unsigned i = 0; i < res->count; i++)
+    sum += res->samples[i];
+  mean = sum / res->count;
+  for (unsigned i = 0; i < res->count; i++)
+    var += (res->samples[i] - mean) * (res->samples[i] - mean);
+  var = res->count > 1 ? var / (res->count - 1) : 0;
+  median = res->count % 2 ? res->samples[res->count / 2]
+                          : (res->samples[res->count / 2 - 1] + res->samples[res->count / 2]) / 2;
+
+  printf("%-28s %12.2f ns/%-6s (mean %.2f, stddev %.2f, min %.2f, max %.2f)\n",
+      res->name, median, res->unit, mean, sqrt(var), res->samples[0], res->samples[res->count - 1]);
+
+  if (json){
+    fprintf(json, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %lu, \"bytes\": %lu, "
+        "\"repetitions\": %u, \"ns_per_op\": {\"median\": %.3f, \"mean\": %.3f, "
+        "\"stddev\": %.3f, \"min\": %.3f, \"max\": %.3f}}",
+        results_count ? "," : "", res->name, res->unit, res->ops, res->bytes, res->count,
+        median, mean, sqrt(var), res->samples[0], res->samples[res->count - 1]);
+  }
+
+  results_count++;
+}
+/* }}} */
+
+/* puts a piece of bytecode in the <code> */
+typedef void (*emitter_t)(code_t *code);
+
+/*
+ * name:        bench_code
+ * description: measures the <op> bytes repeated <ops> times after the <setup>
+ *              against the <setup> repeated with just the <base> after it (so
+ *              the stacks of both end up the same size), both preceded by the
+ *              <once>
+ */
+static void bench_code(const char *name, emitter_t once, emitter_t setup, emitter_t op, emitter_t base)
+{
+  code_t measured = { NULL, 0, 0 }, baseline = { NULL, 0, 0 };
+  result_t res;
+
+  if (!wanted(name))
+    return;
+
+  emit_version(&measured);
+  emit_version(&baseline);
+  if (once){
+    once(&measured);
+    once(&baseline);
+  }
+  for (unsigned long i = 0; i < ops; i++){
+    if (setup){
+      setup(&measured);
+      setup(&baseline);
+    }
+    op(&measured);
+    if (base)
+      base(&baseline);
+  }
+
+  res.name  = name;
+  res.unit  = "op";
+  res.ops   = ops;
+  res.bytes = measured.count;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    double with = run_code(&measured);
+    double without = run_code(&baseline);
+    res.samples[res.count++] = (with - without) / ops;
+  }
+
+  report(&res);
+  free(measured.bytes);
+  free(baseline.bytes);
+}
+
+/* {{{ opcode benchmarks */
+static void one_const(code_t *c)   { emit_const(c, 7); }
+static void two_consts(code_t *c)  { emit_const(c, 1234); emit_const(c, 7); }
+static void three_consts(code_t *c){ emit_const(c, 1); emit_const(c, 2); emit_const(c, 3); }
+static void two_longs(code_t *c)   { emit_long(c, 5000000000LL); emit_long(c, 7); }
+static void two_big_longs(code_t *c){ emit_long(c, INT64_MAX); emit_long(c, INT64_MAX); }
+static void two_doubles(code_t *c) { emit_double(c, 1234.5); emit_double(c, 7.25); }
+static void op_nop(code_t *c)      { emit_op(c, NOP); }
+static void op_load_const(code_t *c){ emit_const(c, 42); }
+static void op_discard(code_t *c)  { emit_op(c, DISCARD); }
+static void op_add(code_t *c)      { emit_op(c, BINARY_ADD); }
+static void op_sub(code_t *c)      { emit_op(c, BINARY_SUB); }
+static void op_mul(code_t *c)      { emit_op(c, BINARY_MUL); }
+static void op_div(code_t *c)      { emit_op(c, BINARY_DIV); }
+static void op_rot_two(code_t *c)  { emit_op(c, ROT_TWO); }
+static void op_rot_three(code_t *c){ emit_op(c, ROT_THREE); }
+static void op_dup(code_t *c)      { emit_op(c, DUP); }
+static void op_store(code_t *c)    { emit_name(c, STORE, "x"); }
+static void op_load_name(code_t *c){ emit_name(c, LOAD_NAME, "x"); }
+static void op_store_local(code_t *c){ emit_slot(c, STORE_LOCAL, 0, 0, "x"); }
+static void op_load_local(code_t *c){ emit_slot(c, LOAD_LOCAL, 0, 0, NULL); }
+static void op_block(code_t *c)    { emit_op(c, ENTER_BLOCK); emit_op(c, LEAVE_BLOCK); }
+static void op_call(code_t *c)     { emit_name(c, CALL, "f"); }
+static void op_call_native(code_t *c){ emit_name(c, CALL, "add"); }
+static void def_x(code_t *c)       { emit_const(c, 5); emit_name(c, STORE, "x"); }
+static void def_f(code_t *c)       { emit_fn(c, "f", 0); emit_op(c, FN_END); }
+/* the body's ops are quickened on the first call */
+static void def_arith(code_t *c)
+{
+  emit_fn(c, "g", 0);
+  emit_op(c, BINARY_ADD);
+  emit_op(c, BINARY_MUL);
+  emit_op(c, BINARY_SUB);
+  emit_op(c, FN_END);
+}
+/* `t` ends calling `f`, so it's a tail call */
+static void def_tail(code_t *c)
+{
+  def_f(c);
+  emit_fn(c, "t", 0);
+  emit_name(c, CALL, "f");
+  emit_op(c, FN_END);
+}
+static void op_call_tail(code_t *c){ emit_name(c, CALL, "t"); }
+/* h(a, b) returns a + b */
+static void def_args(code_t *c)
+{
+  emit_fn(c, "h", 2);
+  emit_op(c, LOAD_ARG); emit_op(c, 0);
+  emit_op(c, LOAD_ARG); emit_op(c, 1);
+  emit_op(c, BINARY_ADD);
+  emit_op(c, RETURN);
+  emit_op(c, FN_END);
+}
+static void op_call_args(code_t *c){ emit_name(c, CALL, "h"); }
+/* the coroutine `c` yields a constant once per resume, all the way through */
+static void def_gen(code_t *c)
+{
+  emit_fn(c, "c", 0);
+  for (unsigned long i = 0; i < ops; i++){
+    emit_const(c, 7);
+    emit_op(c, YIELD);
+  }
+  emit_op(c, FN_END);
+}
+static void op_resume(code_t *c)   { emit_name(c, RESUME, "c"); }
+static void four_consts(code_t *c) { emit_const(c, 1); emit_const(c, 2); emit_const(c, 3); emit_const(c, 4); }
+static void op_call_arith(code_t *c){ emit_name(c, CALL, "g"); }
+static void three_discards(code_t *c){ emit_op(c, DISCARD); emit_op(c, DISCARD); emit_op(c, DISCARD); }
+static void two_discards(code_t *c){ emit_op(c, DISCARD); emit_op(c, DISCARD); }
+static void op_load_short_string(code_t *c){ emit_string(c, "short"); }
+static void op_load_long_string(code_t *c){ emit_string(c, "a string too long to fit in the value"); }
+static void two_short_strings(code_t *c){ emit_string(c, "foo"); emit_string(c, "bar"); }
+static void two_long_strings(code_t *c){ emit_string(c, "a string too long"); emit_string(c, " to fit in the value"); }
+static void op_mul_store(code_t *c){ emit_op(c, BINARY_MUL); emit_name(c, STORE, "x"); }
+static void two_channels(code_t *c){ emit_name(c, CALL, "chan"); emit_name(c, CALL, "chan"); }
+static void op_send_recv(code_t *c){ emit_const(c, 7); emit_op(c, SEND); emit_op(c, RECV); }
+static void op_send_recv_long(code_t *c){ emit_string(c, "a string too long to fit in the value"); emit_op(c, SEND); emit_op(c, RECV); }
+
+static void bench_opcodes(void)
+{
+  bench_code("op/nop",         NULL,         NULL,       op_nop, NULL);
+  bench_code("op/load_const",  NULL,         NULL,       op_load_const, NULL);
+  bench_code("op/discard",     one_const,    one_const,  op_discard, NULL);
+  bench_code("op/add",         NULL,         two_consts, op_add, op_discard);
+  bench_code("op/sub",         NULL,         two_consts, op_sub, op_discard);
+  bench_code("op/mul",         NULL,         two_consts, op_mul, op_discard);
+  bench_code("op/div",         NULL,         two_consts, op_div, op_discard);
+  bench_code("op/add_long",    NULL,         two_longs,  op_add, op_discard);
+  bench_code("op/mul_overflow", NULL,        two_big_longs, op_mul, op_discard);
+  bench_code("op/mul_overflow_store", NULL,  two_big_longs, op_mul_store, two_discards);
+  bench_code("op/add_double",  NULL,         two_doubles, op_add, op_discard);
+  bench_code("op/div_double",  NULL,         two_doubles, op_div, op_discard);
+  bench_code("op/load_short_string", NULL,   NULL,       op_load_short_string, NULL);
+  bench_code("op/load_long_string", NULL,    NULL,       op_load_long_string, NULL);
+  bench_code("op/concat_short", NULL,        two_short_strings, op_add, op_discard);
+  bench_code("op/concat_long", NULL,         two_long_strings, op_add, op_discard);
+  bench_code("op/rot_two",     two_consts,   NULL,       op_rot_two, NULL);
+  bench_code("op/rot_three",   three_consts, NULL,       op_rot_three, NULL);
+  bench_code("op/dup",         one_const,    NULL,       op_dup, NULL);
+  bench_code("op/store",       NULL,         one_const,  op_store, NULL);
+  bench_code("op/load_name",   def_x,        NULL,       op_load_name, NULL);
+  bench_code("op/store_local", def_x,        one_const,  op_store_local, NULL);
+  bench_code("op/load_local",  def_x,        NULL,       op_load_local, NULL);
+  bench_code("op/enter_leave_block", NULL,   NULL,       op_block, NULL);
+  bench_code("call/empty_function",  def_f,  NULL,       op_call, NULL);
+  bench_code("call/tail_call",       def_tail, NULL,     op_call_tail, NULL);
+  bench_code("call/arith_function",  def_arith, four_consts, op_call_arith, three_discards);
+  bench_code("call/args_return",     def_args, two_consts, op_call_args, op_discard);
+  bench_code("call/native_add",      NULL,   two_consts, op_call_native, op_discard);
+  bench_code("coro/resume_yield",    def_gen, NULL,      op_resume, op_load_const);
+
+  /* (every SEND is RECVd right away, so it never fills up) */
+  channel = nvm_channel_new(16);
+  bench_code("chan/send_recv",       NULL,   two_channels, op_send_recv, op_discard);
+  bench_code("chan/send_recv_long_string", NULL, two_channels, op_send_recv_long, op_discard);
+  nvm_channel_free(channel);
+}
+/* }}} */
+
+/* {{{ fuel benchmarks */
+/*
+ * name:        bench_fuel
+ * description: measures the calls of a program that runs out of fuel every
+ *              <slice> of them, and is resumed with more (so the cost includes
+ *              the stopping and the resuming, spread over the slice)
+ */
+static void bench_fuel(void)
+{
+  static const uint64_t slices[] = { 1, 64, 4096 };
+  char name[64];
+
+  for (unsigned i = 0; i < sizeof(slices) / sizeof(slices[0]); i++){
+    slice = slices[i];
+    sprintf(name, "call/fuel/%lu", (unsigned long)slice);
+    bench_code(name, def_f, NULL, op_call, NULL);
+  }
+  slice = 0;
+}
+/* }}} */
+
+/* {{{ variables access benchmarks */
+static unsigned scope_size;
+
+/* `x` goes first, so it's looked up past all the others */
+static void def_scope(code_t *c)
+{
+  char name[16];
+  def_x(c);
+  for (unsigned i = 1; i < scope_size; i++){
+    sprintf(name, "v%u", i);
+    emit_const(c, i);
+    emit_name(c, STORE, name);
+  }
+}
+
+static unsigned scope_depth;
+
+/* `x` in the main block, and the code <scope_depth> blocks in (each with a
+ * few variables of its own) */
+static void def_nested(code_t *c)
+{
+  def_x(c);
+  for (unsigned i = 0; i < scope_depth; i++){
+    emit_op(c, ENTER_BLOCK);
+    for (unsigned j = 0; j < 4; j++){
+      emit_const(c, j);
+      emit_slot(c, STORE_LOCAL, 0, j, "v");
+    }
+  }
+}
+
+static void op_load_outer(code_t *c){ emit_slot(c, LOAD_LOCAL, scope_depth, 0, NULL); }
+
+static unsigned funcs_count;
+
+/* `f` goes first, so it would be searched for past all the others, and `w`
+ * (found right away) calls it, from the same CALL every time */
+static void def_funcs(code_t *c)
+{
+  char name[16];
+  def_f(c);
+  for (unsigned i = 1; i < funcs_count; i++){
+    sprintf(name, "f%u", i);
+    emit_fn(c, name, 0);
+    emit_op(c, FN_END);
+  }
+  emit_fn(c, "w", 0);
+  emit_name(c, CALL, "f");
+  emit_op(c, FN_END);
+}
+static void op_call_w(code_t *c){ emit_name(c, CALL, "w"); }
+
+static void bench_scopes(void)
+{
+  static const unsigned counts[] = { 1, 64, 1024 };
+  static const unsigned sizes[] = { 1, 4, 16, 64, 256 };
+  static const unsigned depths[] = { 1, 4, 16 };
+  char name[64];
+
+  for (unsigned i = 0; i < sizeof(depths) / sizeof(depths[0]); i++){
+    scope_depth = depths[i];
+    sprintf(name, "vars/load_outer/%u", scope_depth);
+    bench_code(name, def_nested, NULL, op_load_outer, NULL);
+    sprintf(name, "vars/load_name_outer/%u", scope_depth);
+    bench_code(name, def_nested, NULL, op_load_name, NULL);
+  }
+
+  for (unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++){
+    funcs_count = counts[i];
+    sprintf(name, "call/among/%u", funcs_count);
+    bench_code(name, def_funcs, NULL, op_call_w, NULL);
+  }
+
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+    scope_size = sizes[i];
+    sprintf(name, "vars/load_name/%u", scope_size);
+    bench_code(name, def_scope, NULL, op_load_name, NULL);
+    sprintf(name, "vars/store/%u", scope_size);
+    bench_code(name, def_scope, one_const, op_store, NULL);
+  }
+}
+/* }}} */
+
+/* {{{ batch benchmarks */
+/*
+ * name:        bench_batch_code
+ * description: measures evaluating the program over <ops> rows of `x` and `y`
+ */
+static void bench_batch_code(const char *name, emitter_t program)
+{
+  /* {{{ bench_batch_code body */
+  code_t code = { NULL, 0, 0 };
+  INT *x = malloc(ops * sizeof(INT)), *y = malloc(ops * sizeof(INT));
+  INT *output = malloc(ops * sizeof(INT));
+  nvm_column inputs[2] = { { "x", x }, { "y", y } };
+  result_t res;
+
+  if (!wanted(name))
+    goto out;
+
+  if (!x || !y || !output){
+    fprintf(stderr, "nvm_bench: failed to allocate the columns\n");
+    exit(1);
+  }
+
+  for (unsigned long row = 0; row < ops; row++){
+    x[row] = rand() % 1000;
+    y[row] = 1 + rand() % 1000;
+  }
+
+  emit_version(&code);
+  program(&code);
+  write_code(&code);
+
+  nvm_t *vm = nvm_init(path, NULL, NULL);
+  nvm_register_native(vm, "score", native_score, 2);
+  nvm_register_vector_native(vm, "vscore", vector_score, 2);
+
+  res.name  = name;
+  res.unit  = "row";
+  res.ops   = ops;
+  res.bytes = code.count;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    double start = now();
+    if (nvm_run_batch(vm, inputs, 2, ops, output) != 0){
+      fprintf(stderr, "nvm_bench: the batch failed\n");
+      exit(1);
+    }
+    res.samples[res.count++] = (now() - start) / ops;
+  }
+
+  report(&res);
+  /* the batch mode leaves the usual stacks alone, so no blastoff is needed */
+  nvm_destroy(vm);
+
+out:
+  free(code.bytes);
+  free(x);
+  free(y);
+  free(output);
+  /* }}} */
+}
+
+/* score(x, y) */
+static void prog_score(code_t *c)
+{
+  emit_name(c, LOAD_NAME, "x");
+  emit_name(c, LOAD_NAME, "y");
+  emit_name(c, CALL, "score");
+}
+
+/* vscore(x, y) */
+static void prog_vscore(code_t *c)
+{
+  emit_name(c, LOAD_NAME, "x");
+  emit_name(c, LOAD_NAME, "y");
+  emit_name(c, CALL, "vscore");
+}
+
+/* (x * y + x - y) / y */
+static void prog_expression(code_t *c)
+{
+  emit_name(c, LOAD_NAME, "x");
+  emit_name(c, LOAD_NAME, "y");
+  emit_op(c, BINARY_MUL);
+  emit_name(c, LOAD_NAME, "x");
+  emit_op(c, BINARY_ADD);
+  emit_name(c, LOAD_NAME, "y");
+  emit_op(c, BINARY_SUB);
+  emit_name(c, LOAD_NAME, "y");
+  emit_op(c, BINARY_DIV);
+}
+
+static void bench_batch(void)
+{
+  const char *kernels[] = { "avx2", "sse4.1", "sse2", "scalar" };
+  const char *best = nvm_batch_kernels();
+  char name[64];
+
+  bench_batch_code("batch/scalar_native", prog_score);
+  bench_batch_code("batch/vector_native", prog_vscore);
+
+  /* the same expression with each of the kernels the CPU has */
+  for (unsigned i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++){
+    if (nvm_use_batch_kernels(kernels[i]))
+      continue;
+    sprintf(name, "batch/expression/%s", kernels[i]);
+    bench_batch_code(name, prog_expression);
+  }
+
+  nvm_use_batch_kernels(best);
+}
+/* }}} */
+
+/* {{{ bigint benchmarks */
+/*
+ * name:        bench_bigint_mul
+ * description: measures multiplying two random bigints of <limbs> limbs
+ */
+static void bench_bigint_mul(size_t limbs)
+{
+  /* {{{ bench_bigint_mul body */
+  unsigned long count = ops / limbs ? ops / limbs : 1;
+  /* the operands are the benchmarks own, so the collector leaves them be */
+  uint32_t *limbs_a = malloc(limbs * sizeof(uint32_t));
+  uint32_t *limbs_b = malloc(limbs * sizeof(uint32_t));
+  nvm_bigint a = { false, limbs, limbs_a }, b = { false, limbs, limbs_b };
+  code_t code = { NULL, 0, 0 };
+  char name[64];
+  result_t res;
+
+  sprintf(name, "bigint/mul/%lu", (unsigned long)limbs);
+  if (!wanted(name))
+    goto out;
+
+  emit_version(&code);
+  write_code(&code);
+
+  res.name  = name;
+  res.unit  = "mul";
+  res.ops   = count;
+  res.bytes = 0;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    nvm_t *vm = nvm_init(path, NULL, NULL);
+
+    for (size_t i = 0; i < limbs; i++){
+      limbs_a[i] = (uint32_t)rand() << 16 ^ rand();
+      limbs_b[i] = (uint32_t)rand() << 16 ^ rand();
+    }
+    limbs_a[limbs - 1] |= 1;
+    limbs_b[limbs - 1] |= 1;
+
+    double start = now();
+    for (unsigned long i = 0; i < count; i++){
+      nvm_bigint_op(vm, BINARY_MUL, &a, &b);
+      nvm_gc_poll(vm);
+    }
+    res.samples[res.count++] = (now() - start) / count;
+
+    nvm_destroy(vm);
+  }
+
+  report(&res);
+
+out:
+  free(code.bytes);
+  free(limbs_a);
+  free(limbs_b);
+  /* }}} */
+}
+
+static void bench_bigint(void)
+{
+  /* around the Karatsuba threshold, and way past it */
+  bench_bigint_mul(8);
+  bench_bigint_mul(31);
+  bench_bigint_mul(32);
+  bench_bigint_mul(128);
+  bench_bigint_mul(1024);
+}
+/* }}} */
+
+/* {{{ string benchmarks */
+/*
+ * name:        bench_string_build
+ * description: measures building a string of <bytes> bytes by appending to it
+ *              16 bytes at a time (`s = s + "..."`), which should cost the same
+ *              per append whatever the size
+ */
+static void bench_string_build(size_t bytes)
+{
+  /* {{{ bench_string_build body */
+  static const char piece[] = "sixteen bytes...";
+  unsigned long appends = bytes / (sizeof(piece) - 1);
+  code_t code = { NULL, 0, 0 };
+  char name[64];
+  result_t res;
+
+  sprintf(name, "string/build/%luK", (unsigned long)bytes / 1024);
+  if (!wanted(name))
+    return;
+
+  emit_version(&code);
+  emit_string(&code, "");
+  emit_name(&code, STORE, "s");
+  for (unsigned long i = 0; i < appends; i++){
+    emit_name(&code, LOAD_NAME, "s");
+    emit_string(&code, piece);
+    emit_op(&code, BINARY_ADD);
+    emit_name(&code, STORE, "s");
+  }
+
+  res.name  = name;
+  res.unit  = "append";
+  res.ops   = appends;
+  res.bytes = code.count;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++)
+    res.samples[res.count++] = run_code(&code) / appends;
+
+  report(&res);
+  free(code.bytes);
+  /* }}} */
+}
+
+static void bench_strings(void)
+{
+  /* from a quarter of a megabyte to a few of them */
+  bench_string_build(256 * 1024);
+  bench_string_build(1024 * 1024);
+  bench_string_build(4 * 1024 * 1024);
+}
+/* }}} */
+
+/* {{{ loading benchmarks */
+/*
+ * name:        bench_loading
+ * description: measures loading, validating and the pre-run of files made of
+ *              <functions> functions definitions
+ */
+static void bench_loading(void)
+{
+  static const unsigned functions[] = { 16, 256, 4096, 65536 };
+  char name[64];
+
+  for (unsigned i = 0; i < sizeof(functions) / sizeof(functions[0]); i++){
+    code_t code = { NULL, 0, 0 };
+    result_t load, validate, prerun;
+    char fn[16];
+
+    emit_version(&code);
+    for (unsigned f = 0; f < functions[i]; f++){
+      sprintf(fn, "f%u", f);
+      emit_fn(&code, fn, 0);
+      two_consts(&code);
+      op_add(&code);
+      op_store(&code);
+      emit_op(&code, FN_END);
+    }
+    write_code(&code);
+
+    sprintf(name, "load/init/%luB", code.count);
+    load.name = strdup(name);
+    sprintf(name, "load/validate/%luB", code.count);
+    validate.name = strdup(name);
+    sprintf(name, "load/prerun/%luB", code.count);
+    prerun.name = strdup(name);
+    load.unit = validate.unit = prerun.unit = "file";
+    load.ops = validate.ops = prerun.ops = 1;
+    load.bytes = validate.bytes = prerun.bytes = code.count;
+    load.count = validate.count = prerun.count = 0;
+
+    for (unsigned r = 0; r < repetitions; r++){
+      double start = now();
+      nvm_t *vm = nvm_init(path, NULL, NULL);
+      load.samples[load.count++] = now() - start;
+
+      start = now();
+      nvm_validate(vm);
+      validate.samples[validate.count++] = now() - start;
+
+      /* there's nothing but the definitions, so it's all the pre-run and
+       * skipping over the bodies */
+      start = now();
+      nvm_blastoff(vm);
+      prerun.samples[prerun.count++] = now() - start;
+
+      nvm_destroy(vm);
+    }
+
+    if (wanted(load.name))
+      report(&load);
+    if (wanted(validate.name))
+      report(&validate);
+    if (wanted(prerun.name))
+      report(&prerun);
+
+    free((char *)load.name);
+    free((char *)validate.name);
+    free((char *)prerun.name);
+    free(code.bytes);
+  }
+}
+/* }}} */
+
+/* {{{ compiling benchmarks */
+/*
+ * name:        bench_compile
+ * description: measures how fast the grammar turns statements into bytecode
+ */
+static void bench_compile(void)
+{
+  /* x = a * (b + 3) - 7 / c; */
+  static const struct { int type; const char *s; int i; } tokens[] = {
+    { NAME, "x", 0 }, { EQ, NULL, 0 }, { NAME, "a", 0 }, { TIMES, NULL, 0 },
+    { LPAREN, NULL, 0 }, { NAME, "b", 0 }, { PLUS, NULL, 0 }, { NUMBER, NULL, 3 },
+    { RPAREN, NULL, 0 }, { MINUS, NULL, 0 }, { NUMBER, NULL, 7 }, { DIVIDE, NULL, 0 },
+    { NAME, "c", 0 }, { SEMICOLON, NULL, 0 }
+  };
+  result_t res;
+
+  if (!wanted("compile/statement"))
+    return;
+
+  res.name  = "compile/statement";
+  res.unit  = "stmt";
+  res.ops   = ops;
+  res.bytes = 0;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    TokenType token;
+
+    fp = fopen(path, "wb");
+    if (!fp){
+      fprintf(stderr, "nvm_bench: couldn't write %s\n", path);
+      exit(1);
+    }
+
+    double start = now();
+    void *parser = ParseAlloc(malloc);
+    for (unsigned long i = 0; i < ops; i++){
+      for (unsigned t = 0; t < sizeof(tokens) / sizeof(tokens[0]); t++){
+        if (tokens[t].s)
+          token.s = (char *)tokens[t].s;
+        else
+          token.i = tokens[t].i;
+        Parse(parser, tokens[t].type, token);
+      }
+    }
+    /* the last statement */
+    token.s = "x";
+    Parse(parser, NAME, token);
+    token.i = 0;
+    Parse(parser, 0, token);
+    ParseFree(parser, free);
+    fflush(fp);
+    res.samples[res.count++] = (now() - start) / ops;
+
+    res.bytes = ftell(fp);
+    fclose(fp);
+  }
+
+  report(&res);
+}
+/* }}} */
+
+/* {{{ async benchmarks */
+/*
+ * name:        bench_await
+ * description: measures <in_flight> VMs at a time awaiting their host
+ *              functions on the event loop (the cost includes the pipes)
+ */
+static void bench_await(unsigned in_flight)
+{
+  /* {{{ bench_await body */
+  unsigned long rounds = ops / (2 * in_flight) ? ops / (2 * in_flight) : 1;
+  nvm_t **vms = malloc(in_flight * sizeof(nvm_t *));
+  code_t code = { NULL, 0, 0 };
+  char name[64];
+  result_t res;
+
+  sprintf(name, "async/await/%u", in_flight);
+  if (!wanted(name) || !vms){
+    free(vms);
+    return;
+  }
+
+  /* fetch(fetch(21) + 1), which is 86 */
+  emit_version(&code);
+  emit_const(&code, 21);
+  emit_name(&code, CALL, "fetch");
+  emit_const(&code, 1);
+  emit_op(&code, BINARY_ADD);
+  emit_name(&code, CALL, "fetch");
+  write_code(&code);
+
+  loop = nvm_loop_init(finished, NULL);
+  if (!loop){
+    fprintf(stderr, "nvm_bench: couldn't create the event loop\n");
+    exit(1);
+  }
+
+  res.name  = name;
+  res.unit  = "await";
+  res.ops   = rounds * in_flight * 2;
+  res.bytes = code.count;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    double elapsed = 0;
+
+    for (unsigned long round = 0; round < rounds; round++){
+      for (unsigned v = 0; v < in_flight; v++){
+        vms[v] = nvm_init(path, NULL, NULL);
+        nvm_register_native(vms[v], "fetch", native_fetch, 1);
+      }
+      async_sum = 0;
+
+      double start = now();
+      for (unsigned v = 0; v < in_flight; v++)
+        nvm_loop_start(loop, vms[v]);
+      nvm_loop_run(loop);
+      elapsed += now() - start;
+
+      if (async_sum != 86LL * in_flight){
+        fprintf(stderr, "nvm_bench: the VMs on the loop got %lld, not %lld\n", async_sum, 86LL * in_flight);
+        exit(1);
+      }
+      for (unsigned v = 0; v < in_flight; v++)
+        nvm_destroy(vms[v]);
+    }
+
+    res.samples[res.count++] = elapsed / res.ops;
+  }
+
+  report(&res);
+  nvm_loop_destroy(loop);
+  free(code.bytes);
+  free(vms);
+  /* }}} */
+}
+
+static void bench_async(void)
+{
+  bench_await(1);
+  bench_await(100);
+  bench_await(1000);
+}
+/* }}} */
+
+/* {{{ scheduler benchmarks */
+/* Number of the VMs the scheduler runs at a time */
+#define SCHED_TASKS 64
+
+/*
+ * name:        bench_sched_threads
+ * description: measures the calls of SCHED_TASKS VMs run side by side by a
+ *              scheduler with <threads> threads, a slice of <slice> calls at a
+ *              time (so the cost includes the switching, and the stealing)
+ */
+static void bench_sched_threads(unsigned threads, uint64_t slice)
+{
+  /* {{{ bench_sched_threads body */
+  nvm_t *vms[SCHED_TASKS];
+  nvm_task *tasks[SCHED_TASKS];
+  code_t code = { NULL, 0, 0 };
+  char name[64];
+  result_t res;
+
+  sprintf(name, "sched/calls/%ut/%lu", threads, (unsigned long)slice);
+  if (!wanted(name))
+    return;
+
+  emit_version(&code);
+  def_f(&code);
+  for (unsigned long i = 0; i < ops; i++)
+    op_call(&code);
+  write_code(&code);
+
+  res.name  = name;
+  res.unit  = "call";
+  res.ops   = ops * SCHED_TASKS;
+  res.bytes = code.count;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    nvm_sched *sched = nvm_sched_init(threads, slice);
+
+    if (!sched){
+      fprintf(stderr, "nvm_bench: couldn't start the scheduler\n");
+      exit(1);
+    }
+    for (unsigned t = 0; t < SCHED_TASKS; t++)
+      vms[t] = nvm_init(path, NULL, NULL);
+
+    double start = now();
+    for (unsigned t = 0; t < SCHED_TASKS; t++)
+      tasks[t] = nvm_sched_spawn(sched, vms[t]);
+    for (unsigned t = 0; t < SCHED_TASKS; t++){
+      if (nvm_sched_join(sched, tasks[t], NULL) != NVM_DONE){
+        fprintf(stderr, "nvm_bench: a VM on the scheduler failed\n");
+        exit(1);
+      }
+    }
+    res.samples[res.count++] = (now() - start) / res.ops;
+
+    for (unsigned t = 0; t < SCHED_TASKS; t++)
+      nvm_destroy(vms[t]);
+    nvm_sched_destroy(sched);
+  }
+
+  report(&res);
+  free(code.bytes);
+  /* }}} */
+}
+
+/*
+ * name:        bench_pipeline
+ * description: measures the values going from one VM to another over a
+ *              channel of <capacity>, the both of them on a scheduler with
+ *              <threads> threads (so the cost includes the parking, when one
+ *              gets ahead of the other)
+ */
+static void bench_pipeline(unsigned threads, size_t capacity)
+{
+  /* {{{ bench_pipeline body */
+  code_t producer = { NULL, 0, 0 }, consumer = { NULL, 0, 0 };
+  char name[64], consumer_path[sizeof(path) + 2];
+  result_t res;
+
+  sprintf(name, "chan/pipeline/%ut/%lu", threads, (unsigned long)capacity);
+  if (!wanted(name))
+    return;
+
+  /* one SENDs 0, 1, 2, ..., the other adds them up */
+  emit_version(&producer);
+  emit_version(&consumer);
+  emit_const(&consumer, 0);
+  for (unsigned long i = 0; i < ops; i++){
+    emit_name(&producer, CALL, "chan");
+    emit_const(&producer, i);
+    emit_op(&producer, SEND);
+    emit_name(&consumer, CALL, "chan");
+    emit_op(&consumer, RECV);
+    emit_op(&consumer, BINARY_ADD);
+  }
+  sprintf(consumer_path, "%s.c", path);
+  write_code(&consumer);
+  rename(path, consumer_path);
+  write_code(&producer);
+
+  res.name  = name;
+  res.unit  = "value";
+  res.ops   = ops;
+  res.bytes = producer.count + consumer.count;
+  res.count = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    nvm_sched *sched = nvm_sched_init(threads, 0);
+    nvm_t *vms[2];
+    nvm_task *tasks[2];
+
+    channel = nvm_channel_new(capacity);
+    if (!sched || !channel){
+      fprintf(stderr, "nvm_bench: couldn't start the scheduler\n");
+      exit(1);
+    }
+    vms[0] = nvm_init(path, NULL, NULL);
+    vms[1] = nvm_init(consumer_path, NULL, NULL);
+    for (unsigned v = 0; v < 2; v++)
+      nvm_register_native(vms[v], "chan", native_channel, 0);
+
+    double start = now();
+    for (unsigned v = 0; v < 2; v++)
+      tasks[v] = nvm_sched_spawn(sched, vms[v]);
+    for (unsigned v = 0; v < 2; v++){
+      if (nvm_sched_join(sched, tasks[v], NULL) != NVM_DONE){
+        fprintf(stderr, "nvm_bench: a VM on the scheduler failed\n");
+        exit(1);
+      }
+    }
+    res.samples[res.count++] = (now() - start) / ops;
+
+    nvm_value *sum = &vms[1]->stack->top[-1];
+    if ((sum->type == LONG ? sum->as.l : sum->as.i) != (int64_t)(ops * (ops - 1) / 2)){
+      fprintf(stderr, "nvm_bench: the values didn't all make it over the channel\n");
+      exit(1);
+    }
+
+    for (unsigned v = 0; v < 2; v++)
+      nvm_destroy(vms[v]);
+    nvm_channel_free(channel);
+    nvm_sched_destroy(sched);
+  }
+
+  report(&res);
+  unlink(consumer_path);
+  free(producer.bytes);
+  free(consumer.bytes);
+  /* }}} */
+}
+
+static void bench_sched(void)
+{
+  bench_sched_threads(1, 64);
+  bench_sched_threads(1, 4096);
+  bench_sched_threads(4, 64);
+  bench_sched_threads(4, 4096);
+  bench_pipeline(1, 2);
+  bench_pipeline(1, 64);
+  bench_pipeline(2, 2);
+  bench_pipeline(2, 64);
+}
+/* }}} */
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: nvm_bench [-n ops] [-r repetitions] [-f filter] [-j file.json]\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *json_path = NULL;
+  int fd;
+
+  for (int i = 1; i < argc; i++){
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      ops = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      repetitions = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+      filter = argv[++i];
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      json_path = argv[++i];
+    else
+      usage();
+  }
+
+  if (!ops || !repetitions || repetitions > MAX_REPETITIONS)
+    usage();
+
+  /* the scratch file every benchmark's bytecode goes through */
+  if ((fd = mkstemp(path)) < 0){
+    fprintf(stderr, "nvm_bench: couldn't create a scratch file\n");
+    return 1;
+  }
+  close(fd);
+
+  if (json_path){
+    json = fopen(json_path, "w");
+    if (!json){
+      fprintf(stderr, "nvm_bench: couldn't write %s\n", json_path);
+      return 1;
+    }
+    fprintf(json, "{\n  \"nvm_version\": \"%u.%u.%u\",\n  \"ops\": %lu,\n  \"repetitions\": %u,\n  \"benchmarks\": [",
+        NVM_VERSION_MAJOR, NVM_VERSION_MINOR, NVM_VERSION_PATCH, ops, repetitions);
+  }
+
+  printf("## NVM %u.%u.%u benchmarks, %lu ops x %u repetitions ##\n\n",
+      NVM_VERSION_MAJOR, NVM_VERSION_MINOR, NVM_VERSION_PATCH, ops, repetitions);
+
+  bench_opcodes();
+  bench_fuel();
+  bench_scopes();
+  bench_batch();
+  bench_bigint();
+  bench_strings();
+  bench_loading();
+  bench_compile();
+  bench_async();
+  bench_sched();
+
+  if (json){
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+  }
+
+  unlink(path);
+
+  return 0;
+}
@@ -0,0 +1,437 @@
+/*
+ *
+ * bigint.c
+ *
+ * Created at:  10/18/2026 10:02:15 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * Arbitrary precision integers.
+ *
+ * The magnitude is an array of 32-bit limbs, the sign is kept aside. Adding
+ * and subtracting go limb by limb, multiplying is the schoolbook method for
+ * the small numbers and Karatsuba's for the ones of at least
+ * KARATSUBA_THRESHOLD limbs, and dividing is Knuth's algorithm D.
+ *
+ * The bigints live on the garbage collected heap.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvm.h"
+#include "bigint.h"
+#include "gc.h"
+
+/* Number of limbs from which on the multiplication is done with Karatsuba's
+ * method (below that the schoolbook one is faster) */
+#define KARATSUBA_THRESHOLD 32
+
+/* {{{ memory */
+nvm_bigint *nvm_bigint_new(nvm_t *vm, size_t count)
+{
+  /* the limbs go right after the header */
+  nvm_bigint *b = nvm_gc_alloc(vm, sizeof(nvm_bigint) + count * sizeof(uint32_t), BIGINT);
+
+  b->negative = false;
+  b->count = count;
+  b->limbs = (uint32_t *)(b + 1);
+
+  return b;
+}
+
+void nvm_bigint_set_long(nvm_bigint *b, uint32_t room[2], int64_t value)
+{
+  /* the magnitude of INT64_MIN doesn't fit in an int64_t */
+  uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+  room[0] = (uint32_t)magnitude;
+  room[1] = (uint32_t)(magnitude >> 32);
+  b->negative = value < 0;
+  b->limbs = room;
+  b->count = room[1] ? 2 : room[0] ? 1 : 0;
+}
+/* }}} */
+
+/* {{{ magnitudes */
+static inline size_t trim(const uint32_t *a, size_t n)
+{
+  while (n && !a[n - 1])
+    n--;
+  return n;
+}
+
+static int compare(const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+  if (an != bn)
+    return an < bn ? -1 : 1;
+
+  while (an--)
+    if (a[an] != b[an])
+      return a[an] < b[an] ? -1 : 1;
+
+  return 0;
+}
+
+/*
+ * name:        add_to
+ * description: r += a, where <an> <= <rn>
+ * return:      the carry out of <r>
+ */
+static uint32_t add_to(uint32_t *r, size_t rn, const uint32_t *a, size_t an)
+{
+  uint64_t carry = 0;
+  size_t i;
+
+  for (i = 0; i < an; i++){
+    carry += (uint64_t)r[i] + a[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  for (; carry && i < rn; i++){
+    carry += r[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+
+  return (uint32_t)carry;
+}
+
+/*
+ * name:        sub_from
+ * description: r -= a, where r >= a (and so <an> <= <rn>)
+ */
+static void sub_from(uint32_t *r, size_t rn, const uint32_t *a, size_t an)
+{
+  int64_t borrow = 0;
+  size_t i;
+
+  for (i = 0; i < an; i++){
+    int64_t d = (int64_t)r[i] - a[i] - borrow;
+    borrow = d < 0;
+    r[i] = (uint32_t)d;
+  }
+  for (; borrow && i < rn; i++){
+    int64_t d = (int64_t)r[i] - borrow;
+    borrow = d < 0;
+    r[i] = (uint32_t)d;
+  }
+}
+
+/*
+ * name:        schoolbook
+ * description: r = a * b, <r> being <an> + <bn> limbs
+ */
+static void schoolbook(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+  memset(r, 0, (an + bn) * sizeof(uint32_t));
+
+  for (size_t i = 0; i < an; i++){
+    uint64_t carry = 0;
+    for (size_t j = 0; j < bn; j++){
+      carry += (uint64_t)a[i] * b[j] + r[i + j];
+      r[i + j] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    r[i + bn] = (uint32_t)carry;
+  }
+}
+
+/*
+ * name:        multiply
+ * description: r = a * b, <r> being <an> + <bn> limbs (and none of the
+ *              operands)
+ */
+static void multiply(nvm_t *vm, uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+  /* {{{ multiply body */
+  if (an < bn){
+    const uint32_t *t = a; a = b; b = t;
+    size_t tn = an; an = bn; bn = tn;
+  }
+
+  if (bn < KARATSUBA_THRESHOLD){
+    schoolbook(r, a, an, b, bn);
+    return;
+  }
+
+  size_t m = an / 2;
+
+  if (bn <= m){
+    /* too lopsided to split both, so r = a0 * b + (a1 * b << m) */
+    uint32_t *t = nvm_alloc(vm, (an - m + bn) * sizeof(uint32_t));
+
+    multiply(vm, r, a, m, b, bn);
+    memset(r + m + bn, 0, (an - m) * sizeof(uint32_t));
+    multiply(vm, t, a + m, an - m, b, bn);
+    add_to(r + m, an + bn - m, t, an - m + bn);
+
+    vm->freeer(t);
+    return;
+  }
+
+  /*
+   * a = a1 B^m + a0, b = b1 B^m + b0, and then
+   *
+   *   a * b = z2 B^2m + z1 B^m + z0
+   *
+   * where z0 = a0 b0, z2 = a1 b1 and z1 = (a0 + a1)(b0 + b1) - z0 - z2
+   */
+  size_t a1n = an - m, b1n = bn - m;
+  size_t san = a1n + 1, sbn = (b1n > m ? b1n : m) + 1;
+  uint32_t *sa = nvm_alloc(vm, (2 * san + 2 * sbn) * sizeof(uint32_t));
+  uint32_t *sb = sa + san, *z1 = sb + sbn;
+  size_t z1n;
+
+  /* z0 and z2 go straight to their places */
+  multiply(vm, r, a, m, b, m);
+  multiply(vm, r + 2 * m, a + m, a1n, b + m, b1n);
+
+  memcpy(sa, a + m, a1n * sizeof(uint32_t));
+  sa[a1n] = 0;
+  add_to(sa, san, a, m);
+  memset(sb, 0, sbn * sizeof(uint32_t));
+  memcpy(sb, b, m * sizeof(uint32_t));
+  add_to(sb, sbn, b + m, b1n);
+  san = trim(sa, san);
+  sbn = trim(sb, sbn);
+
+  multiply(vm, z1, sa, san, sb, sbn);
+  z1n = san + sbn;
+  sub_from(z1, z1n, r, trim(r, 2 * m));
+  sub_from(z1, z1n, r + 2 * m, trim(r + 2 * m, a1n + b1n));
+  add_to(r + m, an + bn - m, z1, trim(z1, z1n));
+
+  vm->freeer(sa);
+  /* }}} */
+}
+
+/*
+ * name:        divide_small
+ * description: q = u / v, for a single limb <v>
+ */
+static void divide_small(uint32_t *q, const uint32_t *u, size_t un, uint32_t v)
+{
+  uint64_t rem = 0;
+
+  for (size_t i = un; i-- > 0;){
+    uint64_t cur = rem << 32 | u[i];
+    q[i] = (uint32_t)(cur / v);
+    rem = cur % v;
+  }
+}
+
+/*
+ * name:        divide
+ * description: q = u / v (Knuth's algorithm D), for <un> >= <vn> >= 2; <q> is
+ *              <un> - <vn> + 1 limbs
+ */
+static void divide(nvm_t *vm, uint32_t *q, const uint32_t *u, size_t un, const uint32_t *v, size_t vn)
+{
+  /* {{{ divide body */
+  const uint64_t base = (uint64_t)1 << 32;
+  /* normalize, so the divisor's top limb has its top bit set */
+  int s = __builtin_clz(v[vn - 1]);
+  uint32_t *nv = nvm_alloc(vm, (vn + un + 1) * sizeof(uint32_t));
+  uint32_t *nu = nv + vn;
+
+  for (size_t i = vn - 1; i > 0; i--)
+    nv[i] = v[i] << s | (s ? v[i - 1] >> (32 - s) : 0);
+  nv[0] = v[0] << s;
+  nu[un] = s ? u[un - 1] >> (32 - s) : 0;
+  for (size_t i = un - 1; i > 0; i--)
+    nu[i] = u[i] << s | (s ? u[i - 1] >> (32 - s) : 0);
+  nu[0] = u[0] << s;
+
+  for (size_t j = un - vn + 1; j-- > 0;){
+    /* estimate the quotient's limb from the top two limbs */
+    uint64_t num = (uint64_t)nu[j + vn] << 32 | nu[j + vn - 1];
+    uint64_t qhat = num / nv[vn - 1];
+    uint64_t rhat = num % nv[vn - 1];
+
+    while (qhat >= base || qhat * nv[vn - 2] > (rhat << 32 | nu[j + vn - 2])){
+      qhat--;
+      rhat += nv[vn - 1];
+      if (rhat >= base)
+        break;
+    }
+
+    /* multiply and subtract */
+    int64_t k = 0, t;
+    for (size_t i = 0; i < vn; i++){
+      uint64_t p = qhat * nv[i];
+      t = (int64_t)nu[i + j] - k - (int64_t)(p & 0xffffffff);
+      nu[i + j] = (uint32_t)t;
+      k = (int64_t)(p >> 32) - (t >> 32);
+    }
+    t = (int64_t)nu[j + vn] - k;
+    nu[j + vn] = (uint32_t)t;
+
+    q[j] = (uint32_t)qhat;
+    /* it was one too many, add it back */
+    if (t < 0){
+      q[j]--;
+      uint64_t carry = 0;
+      for (size_t i = 0; i < vn; i++){
+        carry += (uint64_t)nu[i + j] + nv[i];
+        nu[i + j] = (uint32_t)carry;
+        carry >>= 32;
+      }
+      nu[j + vn] += (uint32_t)carry;
+    }
+  }
+
+  vm->freeer(nv);
+  /* }}} */
+}
+/* }}} */
+
+/*
+ * name:        add_signed
+ * description: a + b, where <b> is negated if <negate_b>
+ */
+static nvm_bigint *add_signed(nvm_t *vm, const nvm_bigint *a, const nvm_bigint *b, bool negate_b)
+{
+  /* {{{ add_signed body */
+  bool b_negative = b->negative != negate_b;
+  nvm_bigint *r;
+
+  if (a->negative == b_negative){
+    const nvm_bigint *big = a->count >= b->count ? a : b;
+    const nvm_bigint *small = big == a ? b : a;
+
+    r = nvm_bigint_new(vm, big->count + 1);
+    memcpy(r->limbs, big->limbs, big->count * sizeof(uint32_t));
+    r->limbs[big->count] = 0;
+    add_to(r->limbs, r->count, small->limbs, small->count);
+    r->negative = a->negative;
+  } else {
+    int cmp = compare(a->limbs, a->count, b->limbs, b->count);
+    const nvm_bigint *big = cmp >= 0 ? a : b;
+    const nvm_bigint *small = big == a ? b : a;
+
+    r = nvm_bigint_new(vm, big->count);
+    memcpy(r->limbs, big->limbs, big->count * sizeof(uint32_t));
+    sub_from(r->limbs, r->count, small->limbs, small->count);
+    r->negative = big == a ? a->negative : b_negative;
+  }
+
+  return r;
+  /* }}} */
+}
+
+nvm_bigint *nvm_bigint_op(nvm_t *vm, BYTE op, const nvm_bigint *a, const nvm_bigint *b)
+{
+  /* {{{ nvm_bigint_op body */
+  nvm_bigint *r;
+
+  switch (op){
+    case BINARY_ADD:
+      r = add_signed(vm, a, b, false);
+      break;
+    case BINARY_SUB:
+      r = add_signed(vm, a, b, true);
+      break;
+    case BINARY_MUL:
+      r = nvm_bigint_new(vm, a->count + b->count);
+      multiply(vm, r->limbs, a->limbs, a->count, b->limbs, b->count);
+      r->negative = a->negative != b->negative;
+      break;
+    default:
+      if (!b->count)
+        return NULL;
+      if (compare(a->limbs, a->count, b->limbs, b->count) < 0){
+        r = nvm_bigint_new(vm, 0);
+        break;
+      }
+      r = nvm_bigint_new(vm, a->count - b->count + 1);
+      if (b->count == 1)
+        divide_small(r->limbs, a->limbs, a->count, b->limbs[0]);
+      else
+        divide(vm, r->limbs, a->limbs, a->count, b->limbs, b->count);
+      r->negative = a->negative != b->negative;
+      break;
+  }
+
+  r->count = trim(r->limbs, r->count);
+  /* there's no negative zero */
+  if (!r->count)
+    r->negative = false;
+
+  return r;
+  /* }}} */
+}
+
+bool nvm_bigint_to_long(const nvm_bigint *b, int64_t *value)
+{
+  uint64_t magnitude;
+
+  if (b->count > 2)
+    return false;
+
+  magnitude = b->count > 1 ? (uint64_t)b->limbs[1] << 32 : 0;
+  magnitude |= b->count ? b->limbs[0] : 0;
+
+  if (b->negative){
+    if (magnitude > (uint64_t)INT64_MAX + 1)
+      return false;
+    *value = (int64_t)(0 - magnitude);
+  } else {
+    if (magnitude > INT64_MAX)
+      return false;
+    *value = (int64_t)magnitude;
+  }
+
+  return true;
+}
+
+double nvm_bigint_to_double(const nvm_bigint *b)
+{
+  double d = 0;
+
+  for (size_t i = b->count; i-- > 0;)
+    d = d * 4294967296.0 + b->limbs[i];
+
+  return b->negative ? -d : d;
+}
+
+void nvm_bigint_print(nvm_t *vm, const nvm_bigint *b, FILE *f)
+{
+  /* {{{ nvm_bigint_print body */
+  /* nine decimal digits at a time, the least significant first */
+  uint32_t *chunks = nvm_alloc(vm, (b->count * 10 / 9 + 1) * sizeof(uint32_t));
+  uint32_t *u = nvm_alloc(vm, b->count * sizeof(uint32_t));
+  size_t un = b->count, count = 0;
+
+  memcpy(u, b->limbs, un * sizeof(uint32_t));
+
+  while (un){
+    uint64_t rem = 0;
+    for (size_t i = un; i-- > 0;){
+      uint64_t cur = rem << 32 | u[i];
+      u[i] = (uint32_t)(cur / 1000000000);
+      rem = cur % 1000000000;
+    }
+    chunks[count++] = (uint32_t)rem;
+    un = trim(u, un);
+  }
+
+  if (!count){
+    fprintf(f, "0");
+  } else {
+    fprintf(f, "%s%u", b->negative ? "-" : "", chunks[count - 1]);
+    while (--count)
+      fprintf(f, "%09u", chunks[count - 1]);
+  }
+
+  vm->freeer(u);
+  vm->freeer(chunks);
+  /* }}} */
+}
@@ -0,0 +1,80 @@
+/*
+ *
+ * bigint.h
+ *
+ * Created at:  10/18/2026 10:02:15 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The arbitrary precision integers the LONG arithmetic overflows into.
+ */
+
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nvm.h"
+
+/*
+ * A BIGINT value (it's what the values' `ptr` points to). They're never
+ * changed once made, so the values can share them.
+ */
+typedef struct {
+  bool negative;
+  /* number of limbs, without the leading zero ones (zero has none) */
+  size_t count;
+  /* the magnitude, the least significant limb first */
+  uint32_t *limbs;
+} nvm_bigint;
+
+/*
+ * name:        nvm_bigint_new
+ * description: makes a (positive) bigint with room for <count> limbs, which
+ *              are left for the caller to fill; it's garbage collected, see
+ *              `nvm_gc_alloc`
+ */
+nvm_bigint *nvm_bigint_new(nvm_t *virtual_machine, size_t count);
+
+/*
+ * name:        nvm_bigint_set_long
+ * description: makes <b> the <value>, using <room> for the limbs (so it can be
+ *              a temporary on the C stack)
+ */
+void nvm_bigint_set_long(nvm_bigint *b, uint32_t room[2], int64_t value);
+
+/*
+ * name:        nvm_bigint_op
+ * description: does the BINARY_* <op> on <a> and <b> (the division truncates
+ *              towards zero, like C does)
+ * return:      the result, or NULL when dividing by zero
+ */
+nvm_bigint *nvm_bigint_op(nvm_t *virtual_machine, BYTE op, const nvm_bigint *a, const nvm_bigint *b);
+
+/*
+ * name:        nvm_bigint_to_long
+ * description: stores the bigint in <value>, if it fits in 64 bits
+ * return:      whether it did fit
+ */
+bool nvm_bigint_to_long(const nvm_bigint *b, int64_t *value);
+
+/*
+ * name:        nvm_bigint_to_double
+ * description: returns the closest double (more or less)
+ */
+double nvm_bigint_to_double(const nvm_bigint *b);
+
+/*
+ * name:        nvm_bigint_print
+ * description: prints the bigint in decimal
+ */
+void nvm_bigint_print(nvm_t *virtual_machine, const nvm_bigint *b, FILE *f);
+
+#endif /* BIGINT_H */
@@ -0,0 +1,341 @@
+/*
+ *
+ * channel.c
+ *
+ * Created at:  10/19/2026 07:31:05 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * Channels.
+ *
+ * A channel is a bounded ring of values, that any number of VMs SEND to and
+ * RECV from at the same time, each on its own thread, with no locks: every
+ * cell has a sequence number that says whose turn it is, the senders and the
+ * receivers claim the cells by bumping their positions with a CAS, and then
+ * they only touch the cells they claimed (the queue of Dmitry Vyukov).
+ *
+ * The VMs don't share their heaps, so a value doesn't go over as it is: the
+ * long STRINGs and the BIGINTs are copied off the heap of the sender as it
+ * SENDs, and onto the heap of the receiver as it RECVs, so neither has to
+ * know anything about the other.
+ *
+ * A VM that can't go on (there's nothing to RECV, or no room to SEND) stops
+ * where it is, and whatever runs it parks it on the channel (see
+ * `nvm_channel_park`), instead of spinning, till the other side wakes it up.
+ * The parked ones are the only thing behind a lock, and it's only taken when
+ * there are some.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "nvm.h"
+#include "channel.h"
+#include "bigint.h"
+#include "str.h"
+
+/* Size of the cache lines the positions are kept apart by */
+#define CACHE_LINE 64
+
+/*
+ * A cell of the ring.
+ */
+typedef struct {
+  /* its position, if it's free to SEND to, and its position + 1, if there's
+   * a value in it to RECV */
+  size_t sequence;
+  /* the value, with the long STRINGs and BIGINTs in their own malloced
+   * copies */
+  nvm_value value;
+} cell_t;
+
+/*
+ * The parked ones of one side.
+ */
+typedef struct {
+  nvm_waiter *head;
+  nvm_waiter *tail;
+} waiters_t;
+
+struct _nvm_channel {
+  cell_t *cells;
+  /* number of the cells, less one (it's a power of two) */
+  size_t mask;
+  char pad0[CACHE_LINE];
+  /* where the next value goes, and where it's taken from (they only grow, the
+   * cell is the position & mask) */
+  size_t enqueue_pos;
+  char pad1[CACHE_LINE];
+  size_t dequeue_pos;
+  char pad2[CACHE_LINE];
+  /* number of the parked ones (of both sides) */
+  size_t parked;
+  /* guards the parked ones */
+  pthread_mutex_t lock;
+  waiters_t receivers;
+  waiters_t senders;
+};
+
+nvm_channel *nvm_channel_new(size_t capacity)
+{
+  /* {{{ nvm_channel_new body */
+  nvm_channel *channel = malloc(sizeof(nvm_channel));
+  size_t size = 2;
+
+  if (!channel)
+    return NULL;
+
+  while (size < capacity)
+    size *= 2;
+
+  channel->cells = malloc(size * sizeof(cell_t));
+  if (!channel->cells){
+    free(channel);
+    return NULL;
+  }
+  for (size_t i = 0; i < size; i++)
+    channel->cells[i].sequence = i;
+
+  channel->mask = size - 1;
+  channel->enqueue_pos = 0;
+  channel->dequeue_pos = 0;
+  channel->parked = 0;
+  channel->receivers.head = channel->receivers.tail = NULL;
+  channel->senders.head = channel->senders.tail = NULL;
+  pthread_mutex_init(&channel->lock, NULL);
+
+  return channel;
+  /* }}} */
+}
+
+/* {{{ copying */
+/*
+ * name:        pack
+ * description: makes <copy> the <value>, with what it points to on the heap
+ *              (if anything) copied off it
+ * return:      whether there was the memory for it
+ */
+static bool pack(nvm_value *copy, const nvm_value *value)
+{
+  /* {{{ pack body */
+  *copy = *value;
+
+  if (value->type == STRING && value->length > NVM_SHORT_STRING){
+    if (!(copy->as.ptr = malloc(value->length)))
+      return false;
+    memcpy(copy->as.ptr, nvm_str_chars(value), value->length);
+  } else if (value->type == BIGINT){
+    const nvm_bigint *b = value->as.ptr;
+    nvm_bigint *c = malloc(sizeof(nvm_bigint) + b->count * sizeof(uint32_t));
+
+    if (!c)
+      return false;
+    c->negative = b->negative;
+    c->count = b->count;
+    c->limbs = (uint32_t *)(c + 1);
+    memcpy(c->limbs, b->limbs, b->count * sizeof(uint32_t));
+    copy->as.ptr = c;
+  }
+
+  return true;
+  /* }}} */
+}
+
+/*
+ * name:        unpack
+ * description: makes <value> the <copy>, with what it points to on the heap
+ *              of the <vm> (if anything), and frees the copy
+ */
+static void unpack(nvm_t *vm, nvm_value *value, const nvm_value *copy)
+{
+  /* {{{ unpack body */
+  if (copy->type == STRING && copy->length > NVM_SHORT_STRING){
+    nvm_str_new(vm, value, copy->as.ptr, copy->length);
+    free(copy->as.ptr);
+  } else if (copy->type == BIGINT){
+    const nvm_bigint *c = copy->as.ptr;
+    nvm_bigint *b = nvm_bigint_new(vm, c->count);
+
+    b->negative = c->negative;
+    memcpy(b->limbs, c->limbs, c->count * sizeof(uint32_t));
+    value->type = BIGINT;
+    value->as.ptr = b;
+    free(copy->as.ptr);
+  } else {
+    *value = *copy;
+  }
+  /* }}} */
+}
+
+/*
+ * name:        discard
+ * description: frees the <copy>
+ */
+static void discard(const nvm_value *copy)
+{
+  if ((copy->type == STRING && copy->length > NVM_SHORT_STRING) || copy->type == BIGINT)
+    free(copy->as.ptr);
+}
+/* }}} */
+
+void nvm_channel_free(nvm_channel *channel)
+{
+  /* {{{ nvm_channel_free body */
+  for (size_t pos = channel->dequeue_pos; pos != channel->enqueue_pos; pos++)
+    discard(&channel->cells[pos & channel->mask].value);
+
+  pthread_mutex_destroy(&channel->lock);
+  free(channel->cells);
+  free(channel);
+  /* }}} */
+}
+
+/* {{{ parking */
+/*
+ * name:        wake
+ * description: wakes up the first of the parked <waiters> of the <channel>
+ *              (if there's any), after the other side did its thing
+ */
+static void wake(nvm_channel *channel, waiters_t *waiters)
+{
+  /* {{{ wake body */
+  nvm_waiter *waiter;
+
+  /* what was done has to be seen by the ones parking (see
+   * `nvm_channel_park`), before they're looked for */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!__atomic_load_n(&channel->parked, __ATOMIC_SEQ_CST))
+    return;
+
+  pthread_mutex_lock(&channel->lock);
+  waiter = waiters->head;
+  if (waiter){
+    waiters->head = waiter->next;
+    if (!waiters->head)
+      waiters->tail = NULL;
+    __atomic_sub_fetch(&channel->parked, 1, __ATOMIC_SEQ_CST);
+  }
+  pthread_mutex_unlock(&channel->lock);
+
+  if (waiter)
+    waiter->wake(waiter);
+  /* }}} */
+}
+
+bool nvm_channel_park(nvm_t *vm, nvm_waiter *waiter)
+{
+  /* {{{ nvm_channel_park body */
+  nvm_channel *channel = vm->blocked;
+  bool sending = vm->blocked_sending;
+  waiters_t *waiters = sending ? &channel->senders : &channel->receivers;
+  size_t enqueued, dequeued;
+
+  pthread_mutex_lock(&channel->lock);
+
+  /* it's counted before it looks at the channel, and the other side looks at
+   * the count after it's done with it, so either it sees what the other side
+   * did, or the other side sees it (and wakes it up) */
+  __atomic_add_fetch(&channel->parked, 1, __ATOMIC_SEQ_CST);
+  enqueued = __atomic_load_n(&channel->enqueue_pos, __ATOMIC_SEQ_CST);
+  dequeued = __atomic_load_n(&channel->dequeue_pos, __ATOMIC_SEQ_CST);
+
+  if (sending ? enqueued - dequeued <= channel->mask : enqueued != dequeued){
+    __atomic_sub_fetch(&channel->parked, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&channel->lock);
+    return false;
+  }
+
+  waiter->next = NULL;
+  if (waiters->tail)
+    waiters->tail->next = waiter;
+  else
+    waiters->head = waiter;
+  waiters->tail = waiter;
+
+  pthread_mutex_unlock(&channel->lock);
+
+  return true;
+  /* }}} */
+}
+/* }}} */
+
+bool nvm_channel_send(nvm_channel *channel, const nvm_value *value)
+{
+  /* {{{ nvm_channel_send body */
+  size_t pos = __atomic_load_n(&channel->enqueue_pos, __ATOMIC_RELAXED);
+  cell_t *cell;
+
+  for (;;){
+    cell = &channel->cells[pos & channel->mask];
+    size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+    if (diff == 0){
+      /* it's free, claim it (the CAS updates the <pos> if it fails) */
+      if (__atomic_compare_exchange_n(&channel->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0){
+      /* the value from a lap ago is still there, so it's full */
+      return false;
+    } else {
+      /* another one claimed it first */
+      pos = __atomic_load_n(&channel->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  if (!pack(&cell->value, value)){
+    fprintf(stderr, "nvm: error: no memory to send a value over a channel\n");
+    exit(1);
+  }
+  /* it's there for the taking */
+  __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+
+  wake(channel, &channel->receivers);
+
+  return true;
+  /* }}} */
+}
+
+bool nvm_channel_recv(nvm_t *vm, nvm_channel *channel, nvm_value *value)
+{
+  /* {{{ nvm_channel_recv body */
+  size_t pos = __atomic_load_n(&channel->dequeue_pos, __ATOMIC_RELAXED);
+  cell_t *cell;
+  nvm_value copy;
+
+  for (;;){
+    cell = &channel->cells[pos & channel->mask];
+    size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+    if (diff == 0){
+      if (__atomic_compare_exchange_n(&channel->dequeue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0){
+      /* nothing was sent to it yet, so it's empty */
+      return false;
+    } else {
+      pos = __atomic_load_n(&channel->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  copy = cell->value;
+  /* it's free for the next lap */
+  __atomic_store_n(&cell->sequence, pos + channel->mask + 1, __ATOMIC_RELEASE);
+
+  unpack(vm, value, &copy);
+
+  wake(channel, &channel->senders);
+
+  return true;
+  /* }}} */
+}
@@ -0,0 +1,95 @@
+/*
+ *
+ * channel.h
+ *
+ * Created at:  10/19/2026 07:31:05 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The channels the VMs (on the same thread, or not) pass the values over, with
+ * SEND and RECV.
+ */
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nvm.h"
+
+/*
+ * NVM type for what waits for a channel: a VM that couldn't SEND or RECV
+ * (see `nvm_channel_park`). It's meant to be a part of whatever runs the VM.
+ */
+typedef struct _nvm_waiter {
+  /* called once the channel may let the VM do it (from the thread of the VM
+   * that RECVd or SENT) */
+  void (*wake)(struct _nvm_waiter *waiter);
+  struct _nvm_waiter *next;
+} nvm_waiter;
+
+/*
+ * name:        nvm_channel_new
+ * description: makes a channel with room for <capacity> values (rounded up
+ *              to a power of two) for the VMs to share; it's the hosts, it
+ *              has to outlive the VMs that have it
+ * return:      the channel, or NULL if there was no memory for it
+ */
+nvm_channel *nvm_channel_new(size_t capacity);
+
+/*
+ * name:        nvm_channel_free
+ * description: frees the <channel>, with the values still in it
+ */
+void nvm_channel_free(nvm_channel *channel);
+
+/*
+ * name:        nvm_channel_value
+ * description: makes <value> the <channel> (for the host functions to hand it
+ *              over to the bytecode)
+ */
+static inline void nvm_channel_value(nvm_value *value, nvm_channel *channel)
+{
+  value->type = CHANNEL;
+  value->length = 0;
+  value->as.ptr = channel;
+}
+
+/*
+ * name:        nvm_channel_send
+ * description: puts a copy of the <value> in the <channel> (so the VM it's
+ *              from can collect it), and wakes up a VM that waits to RECV
+ * return:      whether it went in (it didn't if the channel is full)
+ */
+bool nvm_channel_send(nvm_channel *channel, const nvm_value *value);
+
+/*
+ * name:        nvm_channel_recv
+ * description: takes the next value off the <channel> and writes it to
+ *              <value>, on the heap of the <virtual_machine> (so it's
+ *              collected, see `nvm_gc_alloc`), and wakes up a VM that waits
+ *              to SEND
+ * return:      whether there was one
+ */
+bool nvm_channel_recv(nvm_t *virtual_machine, nvm_channel *channel, nvm_value *value);
+
+/*
+ * name:        nvm_channel_park
+ * description: makes the <waiter> wait for the channel the <virtual_machine>
+ *              is blocked on (see NVM_BLOCKED), until there's something in it
+ *              or room in it (whichever the VM waits for), when it's woken up
+ *              (once), and the VM can be resumed; the waiter can't be touched
+ *              after it's parked, it may be woken up right away, on another
+ *              thread
+ * return:      whether it was parked (it isn't if the channel is ready
+ *              already, and the VM can be resumed right away)
+ */
+bool nvm_channel_park(nvm_t *virtual_machine, nvm_waiter *waiter);
+
+#endif /* CHANNEL_H */
@@ -31,10 +31,18 @@ void  ParseFree(void *, void (*)(void*));
 
 int main(int argc, char *argv[])
 {
-  /* don't complain about unused variable */
-  (void)argc;
+  bool write = false, trace = false, profile = false;
 
-  if (argc > 1 && !strcmp(argv[1], "--write")){
+  for (int i = 1; i < argc; i++){
+    if (!strcmp(argv[i], "--write"))
+      write = true;
+    else if (!strcmp(argv[i], "--trace"))
+      trace = true;
+    else if (!strcmp(argv[i], "--profile"))
+      profile = true;
+  }
+
+  if (write){
     /* opening the testing file */
     fp = fopen("bytecode.nc", "wb");
     /* writing version numbers */
@@ -56,7 +64,7 @@ int main(int argc, char *argv[])
      */
     TokenType token;
     token.s = "a";
-    Parse(parser, STRING, token);
+    Parse(parser, NAME, token);
     token.i = 0;
     Parse(parser, EQ, token);
     token.i = 7;
@@ -64,11 +72,11 @@ int main(int argc, char *argv[])
     token.i = 0;
     Parse(parser, SEMICOLON, token);
     token.s = "b";
-    Parse(parser, STRING, token);
+    Parse(parser, NAME, token);
     token.i = 0;
     Parse(parser, EQ, token);
     token.s = "a";
-    Parse(parser, STRING, token);
+    Parse(parser, NAME, token);
     token.i = 0;
     Parse(parser, MINUS, token);
     token.i = 3;
@@ -95,10 +103,29 @@ int main(int argc, char *argv[])
     fprintf(stderr, "nvm: bytecode validation failed\n");
     exit(1);
   }
+  /* trace every instruction to stdout */
+  if (trace)
+    nvm_set_trace(vm, true, NULL, NULL);
+  /* sample the NVM functions */
+  if (profile && nvm_profiler_start(vm, NVM_PROFILER_DEFAULT_HZ, 0) != 0)
+    fprintf(stderr, "nvm: couldn't start the profiler\n");
   /* starts off the reading from file and executing the ops process */
   nvm_blastoff(vm);
+  /* write the sampled stacks, ready for flame graphs */
+  if (profile){
+    FILE *folded = fopen("profile.folded", "w");
+    if (folded){
+      nvm_profiler_stop(vm);
+      nvm_profiler_dump(vm, folded);
+      fclose(folded);
+    }
+  }
   /* print what's on the stack */
   nvm_print_stack(vm);
+#if NVM_STATS
+  /* and how much each opcode was executed */
+  nvm_print_stats(vm);
+#endif
   /* clean after yourself */
   nvm_destroy(vm);
 
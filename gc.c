@@ -0,0 +1,537 @@
+/*
+ *
+ * gc.c
+ *
+ * Created at:  10/18/2026 11:20:48 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * A precise, generational garbage collector for the values that don't fit in
+ * the nvm_value itself.
+ *
+ * The new small objects are bump allocated in the nursery. Most of them are
+ * dead by the time it fills up, and the minor collection copies the few that
+ * aren't into the old generation, after which the whole nursery is free again.
+ * Since the objects never change once made, an old one can't point to a young
+ * one, so the only pointers into the nursery are in the roots: the Main Stacks
+ * and the variables that were stored to since the last collection (which the
+ * write barrier in STORE remembers, see `nvm_gc_write_barrier`).
+ *
+ * The old generation is collected with mark & sweep. Its small objects are
+ * carved out of NVM_GC_PAGE_SIZE pages, every page holding cells of one size
+ * class (16 to 2048 bytes, powers of two) with a free list per class; the
+ * bigger ones (which skip the nursery) are allocated one by one. The major
+ * collection happens when the bytes that got into the old generation since
+ * the last one cross the threshold (twice what was live after the last one,
+ * but at least NVM_GC_INITIAL_THRESHOLD). Its roots are the Main Stacks and
+ * the variables of every block, of all the coroutines; since the values say
+ * exactly what they are, nothing is guessed.
+ *
+ * Neither collection happens in the middle of an instruction (where the C
+ * code may still hold pointers to the objects being moved), allocating only
+ * notes that one is due, and `nvm_gc_poll` does it once the instruction is
+ * done.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvm.h"
+#include "gc.h"
+#include "bigint.h"
+#include "str.h"
+
+/* Number of the size classes */
+#define CLASSES 8
+/* Size of the smallest class (every next one is twice as big) */
+#define MIN_CELL 16
+/* Size of the biggest class, the ones above are allocated separately */
+#define MAX_CELL (MIN_CELL << (CLASSES - 1))
+
+/* flags of the objects */
+#define USED      0x01
+#define MARKED    0x02
+/* a nursery object that was copied to the old generation (the <next> says
+ * where to) */
+#define FORWARDED 0x04
+
+/*
+ * The header of every object.
+ */
+typedef struct _object {
+  /* the next free cell of the class, the next large object, or where the
+   * object was copied to */
+  struct _object *next;
+  /* size of the cell, or of the whole large (or nursery) object */
+  uint32_t size;
+  /* type of the values that point to it */
+  BYTE type;
+  /* USED, MARKED and FORWARDED */
+  BYTE flags;
+} object_t;
+
+/*
+ * The header of a page.
+ */
+typedef struct _page {
+  struct _page *next;
+  /* size of its cells */
+  uint32_t cell;
+} page_t;
+
+/* the headers are rounded up, so the objects are aligned well enough */
+#define OBJECT_HEADER ((sizeof(object_t) + 15) & ~(size_t)15)
+#define PAGE_HEADER ((sizeof(page_t) + 15) & ~(size_t)15)
+
+#define PAYLOAD(obj) ((void *)((char *)(obj) + OBJECT_HEADER))
+#define OBJECT(ptr) ((object_t *)((char *)(ptr) - OBJECT_HEADER))
+
+struct _nvm_heap {
+  /* the nursery, <top> being where the next object goes */
+  char *nursery;
+  char *top;
+  char *end;
+  /* the pages of the small objects */
+  page_t *pages;
+  /* free cells of every class */
+  object_t *free[CLASSES];
+  /* the large objects */
+  object_t *large;
+  /* bytes that got into the old generation since the last major collection */
+  size_t since;
+  /* the major collection happens once <since> gets here */
+  size_t threshold;
+  /* whether a collection is due (see `nvm_gc_poll`) */
+  bool pending;
+  /* the objects that were marked (or copied), but whose children weren't
+   * yet */
+  object_t **marks;
+  size_t marks_count;
+  size_t marks_size;
+  nvm_gc_stats_t stats;
+};
+
+static nvm_heap *heap(nvm_t *vm)
+{
+  if (!vm->heap){
+    nvm_heap *h = nvm_alloc(vm, sizeof(nvm_heap));
+    memset(h, 0, sizeof(nvm_heap));
+    h->threshold = NVM_GC_INITIAL_THRESHOLD;
+    h->nursery = nvm_alloc(vm, vm->nursery_size);
+    h->top = h->nursery;
+    h->end = h->nursery + vm->nursery_size;
+    vm->heap = h;
+  }
+
+  return vm->heap;
+}
+
+static inline bool is_young(const nvm_heap *h, const void *ptr)
+{
+  return (const char *)ptr >= h->nursery && (const char *)ptr < h->end;
+}
+
+/*
+ * name:        push
+ * description: puts the object on the list of the ones whose children are
+ *              yet to be visited
+ */
+static void push(nvm_t *vm, object_t *obj)
+{
+  nvm_heap *h = vm->heap;
+
+  if (h->marks_count == h->marks_size){
+    size_t size = h->marks_size ? h->marks_size * 2 : 64;
+    object_t **marks = nvm_alloc(vm, size * sizeof(object_t *));
+    if (h->marks){
+      memcpy(marks, h->marks, h->marks_count * sizeof(object_t *));
+      vm->freeer(h->marks);
+    }
+    h->marks = marks;
+    h->marks_size = size;
+  }
+  h->marks[h->marks_count++] = obj;
+}
+
+/* what's done with every value found (the roots and the objects' children) */
+typedef void (*visitor)(nvm_t *vm, nvm_value *value);
+
+static void visit_vars(nvm_t *vm, nvm_var *from, nvm_var *to, visitor visit)
+{
+  for (; from != to; from++)
+    visit(vm, &from->value);
+}
+
+/*
+ * name:        visit_children
+ * description: visits the values the object points to
+ */
+static void visit_children(nvm_t *vm, object_t *obj, visitor visit)
+{
+  switch (obj->type){
+    /* the bigints and strings point to nothing */
+    default:
+      (void)vm;
+      (void)visit;
+      break;
+  }
+}
+
+/*
+ * name:        visit_roots
+ * description: visits the Main Stacks and the variables of every coroutine
+ *              (and what the program yielded); with <all> false only the
+ *              variables of the blocks the write barrier remembered (and
+ *              forgets them)
+ */
+static void visit_roots(nvm_t *vm, visitor visit, bool all)
+{
+  /* {{{ visit_roots body */
+  for (nvm_coroutine *co = vm->main; co != NULL; co = co->next){
+    for (nvm_value *p = co->stack->base; p != co->stack->top; p++)
+      visit(vm, p);
+
+    if (all)
+      visit_vars(vm, co->locals->base, co->locals->top, visit);
+
+    for (nvm_block *p = co->blocks->base; p != co->blocks->top; p++){
+      if (!all && p->remembered)
+        visit_vars(vm, co->locals->base + p->base,
+            p + 1 != co->blocks->top ? co->locals->base + p[1].base : co->locals->top, visit);
+      p->remembered = false;
+    }
+  }
+
+  if (vm->suspended)
+    visit(vm, &vm->yielded);
+
+  while (vm->heap->marks_count)
+    visit_children(vm, vm->heap->marks[--vm->heap->marks_count], visit);
+  /* }}} */
+}
+
+/* {{{ marking */
+static void mark_value(nvm_t *vm, nvm_value *value)
+{
+  object_t *obj;
+
+  if (!nvm_gc_is_heap(value))
+    return;
+
+  obj = OBJECT(value->as.ptr);
+  if (obj->flags & MARKED)
+    return;
+  obj->flags |= MARKED;
+  push(vm, obj);
+}
+/* }}} */
+
+/* {{{ sweeping */
+static unsigned class_of(size_t size)
+{
+  unsigned class = 0;
+
+  while ((size_t)MIN_CELL << class < size)
+    class++;
+
+  return class;
+}
+
+static void sweep(nvm_t *vm)
+{
+  /* {{{ sweep body */
+  nvm_heap *h = vm->heap;
+  size_t live = 0;
+
+  /* the free lists are made anew */
+  memset(h->free, 0, sizeof(h->free));
+
+  for (page_t *page = h->pages; page != NULL; page = page->next){
+    unsigned class = class_of(page->cell);
+    char *end = (char *)page + NVM_GC_PAGE_SIZE - page->cell + 1;
+
+    for (char *p = (char *)page + PAGE_HEADER; p < end; p += page->cell){
+      object_t *obj = (object_t *)p;
+
+      if (obj->flags & MARKED){
+        obj->flags &= ~MARKED;
+        live += obj->size;
+        continue;
+      }
+      if (obj->flags & USED){
+        h->stats.freed += obj->size;
+        obj->flags = 0;
+      }
+      obj->next = h->free[class];
+      h->free[class] = obj;
+    }
+  }
+
+  for (object_t **p = &h->large; *p != NULL;){
+    object_t *obj = *p;
+
+    if (obj->flags & MARKED){
+      obj->flags &= ~MARKED;
+      live += obj->size;
+      p = &obj->next;
+    } else {
+      *p = obj->next;
+      h->stats.freed += obj->size;
+      vm->freeer(obj);
+    }
+  }
+
+  h->stats.live = live;
+  /* }}} */
+}
+/* }}} */
+
+/*
+ * name:        new_page
+ * description: adds a page of cells of the class to its free list
+ */
+static void new_page(nvm_t *vm, unsigned class)
+{
+  nvm_heap *h = vm->heap;
+  page_t *page = nvm_alloc(vm, NVM_GC_PAGE_SIZE);
+  uint32_t cell = MIN_CELL << class;
+  char *end = (char *)page + NVM_GC_PAGE_SIZE - cell + 1;
+
+  page->cell = cell;
+  page->next = h->pages;
+  h->pages = page;
+
+  for (char *p = (char *)page + PAGE_HEADER; p < end; p += cell){
+    object_t *obj = (object_t *)p;
+    obj->flags = 0;
+    obj->next = h->free[class];
+    h->free[class] = obj;
+  }
+}
+
+/*
+ * name:        old_alloc
+ * description: allocates an object of <total> bytes (with the header) in the
+ *              old generation
+ */
+static object_t *old_alloc(nvm_t *vm, size_t total)
+{
+  /* {{{ old_alloc body */
+  nvm_heap *h = vm->heap;
+  object_t *obj;
+
+  if (total > MAX_CELL){
+    obj = nvm_alloc(vm, total);
+    obj->size = total;
+    obj->next = h->large;
+    h->large = obj;
+  } else {
+    unsigned class = class_of(total);
+    if (!h->free[class])
+      new_page(vm, class);
+    obj = h->free[class];
+    h->free[class] = obj->next;
+    obj->size = MIN_CELL << class;
+  }
+
+  h->since += obj->size;
+  if (h->since >= h->threshold)
+    h->pending = true;
+
+  return obj;
+  /* }}} */
+}
+
+/* {{{ copying */
+/*
+ * name:        moved
+ * description: fixes up the pointers the object has into itself
+ */
+static void moved(object_t *obj)
+{
+  switch (obj->type){
+    case BIGINT: {
+      nvm_bigint *b = PAYLOAD(obj);
+      b->limbs = (uint32_t *)(b + 1);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/*
+ * name:        evacuate
+ * description: copies the object the value points to out of the nursery (if
+ *              it's there and wasn't copied already), and points the value to
+ *              the copy
+ */
+static void evacuate(nvm_t *vm, nvm_value *value)
+{
+  /* {{{ evacuate body */
+  nvm_heap *h = vm->heap;
+  object_t *obj, *copy;
+
+  if (!nvm_gc_is_heap(value) || !is_young(h, value->as.ptr))
+    return;
+
+  obj = OBJECT(value->as.ptr);
+  if (!(obj->flags & FORWARDED)){
+    copy = old_alloc(vm, obj->size);
+    copy->type = obj->type;
+    copy->flags = USED;
+    memcpy(PAYLOAD(copy), PAYLOAD(obj), obj->size - OBJECT_HEADER);
+    moved(copy);
+    h->stats.promoted += copy->size;
+
+    obj->flags |= FORWARDED;
+    obj->next = copy;
+    push(vm, copy);
+  }
+
+  value->as.ptr = PAYLOAD(obj->next);
+  /* }}} */
+}
+
+/*
+ * name:        minor
+ * description: the minor collection, empties the nursery
+ */
+static void minor(nvm_t *vm)
+{
+  /* {{{ minor body */
+  nvm_heap *h = vm->heap;
+  uint64_t promoted = h->stats.promoted;
+
+  visit_roots(vm, evacuate, false);
+
+  h->stats.freed += (h->top - h->nursery) - (h->stats.promoted - promoted);
+  h->stats.minor_collections++;
+  h->top = h->nursery;
+  /* }}} */
+}
+/* }}} */
+
+/*
+ * name:        major
+ * description: the major collection (the nursery has to be empty)
+ */
+static void major(nvm_t *vm)
+{
+  /* {{{ major body */
+  nvm_heap *h = vm->heap;
+
+  visit_roots(vm, mark_value, true);
+  nvm_str_visit_interned(vm, mark_value);
+  while (h->marks_count)
+    visit_children(vm, h->marks[--h->marks_count], mark_value);
+  sweep(vm);
+
+  h->stats.collections++;
+  h->since = 0;
+  h->threshold = h->stats.live * 2 > NVM_GC_INITIAL_THRESHOLD ? h->stats.live * 2 : NVM_GC_INITIAL_THRESHOLD;
+  /* }}} */
+}
+
+void nvm_gc(nvm_t *vm)
+{
+  heap(vm);
+  minor(vm);
+  major(vm);
+  vm->heap->pending = false;
+}
+
+void nvm_gc_poll(nvm_t *vm)
+{
+  /* {{{ nvm_gc_poll body */
+  nvm_heap *h = vm->heap;
+
+  if (!h || !h->pending)
+    return;
+
+  minor(vm);
+  if (h->since >= h->threshold)
+    major(vm);
+  h->pending = false;
+  /* }}} */
+}
+
+void *nvm_gc_alloc(nvm_t *vm, size_t size, nvm_value_type type)
+{
+  /* {{{ nvm_gc_alloc body */
+  nvm_heap *h = heap(vm);
+  size_t total = (OBJECT_HEADER + size + 15) & ~(size_t)15;
+  object_t *obj;
+
+  if (total <= MAX_CELL && total <= (size_t)(h->end - h->top)){
+    /* the usual case, it just goes to the nursery */
+    obj = (object_t *)h->top;
+    h->top += total;
+    obj->size = total;
+  } else {
+    /* the big ones skip the nursery, and so do the small ones when it's full
+     * (until the collection empties it) */
+    if (total <= MAX_CELL)
+      h->pending = true;
+    obj = old_alloc(vm, total);
+  }
+
+  obj->type = type;
+  obj->flags = USED;
+  h->stats.allocated += obj->size;
+
+  return PAYLOAD(obj);
+  /* }}} */
+}
+
+void *nvm_gc_alloc_old(nvm_t *vm, size_t size, nvm_value_type type)
+{
+  /* {{{ nvm_gc_alloc_old body */
+  nvm_heap *h = heap(vm);
+  object_t *obj = old_alloc(vm, (OBJECT_HEADER + size + 15) & ~(size_t)15);
+
+  obj->type = type;
+  obj->flags = USED;
+  h->stats.allocated += obj->size;
+
+  return PAYLOAD(obj);
+  /* }}} */
+}
+
+const nvm_gc_stats_t *nvm_gc_stats(nvm_t *vm)
+{
+  return &heap(vm)->stats;
+}
+
+void nvm_gc_free_all(nvm_t *vm)
+{
+  /* {{{ nvm_gc_free_all body */
+  nvm_heap *h = vm->heap;
+  void *next;
+
+  if (!h)
+    return;
+
+  for (page_t *p = h->pages; p != NULL; p = next){
+    next = p->next;
+    vm->freeer(p);
+  }
+  for (object_t *p = h->large; p != NULL; p = next){
+    next = p->next;
+    vm->freeer(p);
+  }
+  if (h->marks)
+    vm->freeer(h->marks);
+  vm->freeer(h->nursery);
+
+  vm->freeer(h);
+  vm->heap = NULL;
+  /* }}} */
+}
@@ -0,0 +1,72 @@
+/*
+ *
+ * gc.h
+ *
+ * Created at:  10/18/2026 11:20:48 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The bits of the garbage collector the rest of the VM needs to know about.
+ */
+
+#ifndef GC_H
+#define GC_H
+
+#include "nvm.h"
+
+/*
+ * name:        nvm_gc_is_heap
+ * description: whether the value points to an object on the heap
+ */
+static inline bool nvm_gc_is_heap(const nvm_value *value)
+{
+  return value->type == BIGINT || (value->type == STRING && value->length > NVM_SHORT_STRING);
+}
+
+/*
+ * name:        nvm_gc_write_barrier
+ * description: has to be called whenever the <value> is stored in a variable
+ *              of the <block>, so the minor collection knows to look at it
+ */
+static inline void nvm_gc_write_barrier(nvm_block *block, const nvm_value *value)
+{
+  if (nvm_gc_is_heap(value))
+    block->remembered = true;
+}
+
+/*
+ * name:        nvm_gc_alloc
+ * description: allocates an object of <size> bytes that the values of the
+ *              <type> point to; it's freed (or moved) once nothing points to
+ *              it anymore, but never before the next `nvm_gc_poll`, so by then
+ *              the value has to be somewhere the VM can see it
+ */
+void *nvm_gc_alloc(nvm_t *virtual_machine, size_t size, nvm_value_type type);
+
+/*
+ * name:        nvm_gc_alloc_old
+ * description: the same as `nvm_gc_alloc`, but the object skips the nursery
+ *              (for the ones that are known to live long, and must not move)
+ */
+void *nvm_gc_alloc_old(nvm_t *virtual_machine, size_t size, nvm_value_type type);
+
+/*
+ * name:        nvm_gc_poll
+ * description: does the collection, if one is due; it may move the objects
+ *              that were allocated since the last one, so it's only called
+ *              between the instructions
+ */
+void nvm_gc_poll(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_gc_free_all
+ * description: frees the whole heap
+ */
+void nvm_gc_free_all(nvm_t *virtual_machine);
+
+#endif /* GC_H */
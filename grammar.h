@@ -0,0 +1,13 @@
+#define NUMBER                          1
+#define NAME                            2
+#define TEXT                            3
+#define EQ                              4
+#define PLUS                            5
+#define MINUS                           6
+#define TIMES                           7
+#define DIVIDE                          8
+#define LPAREN                          9
+#define SEMICOLON                      10
+#define RBRACE                         11
+#define LBRACE                         12
+#define RPAREN                         13
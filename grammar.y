@@ -8,7 +8,8 @@
 %token_type { TokenType }
 
 %type NUMBER { TokenType }
-%type STRING { TokenType }
+%type NAME { TokenType }
+%type TEXT { TokenType }
 
 %right EQ.
 %left  PLUS MINUS.
@@ -20,21 +21,24 @@
   #include <stdlib.h>
   #include <stdint.h>
   #include <string.h>
+  #include <stdbool.h>
 
   #include "nvm.h"
 
   void write_push(int);
+  void write_text(char *);
   void write_binop(BYTE);
   void write_store(BYTE, char *);
   void write_get(BYTE, char *);
+  void write_enter(void);
+  void write_leave(void);
+  void forget_names(void);
 
   typedef union {
     int i;
     char *s;
   } TokenType;
 
-  static uint16_t pc = 0;
-
   extern FILE *fp;
 }
 
@@ -50,12 +54,30 @@
   /* NULL */
 }
 
+/* the names are only good for the source they're in */
+%parse_accept {
+  forget_names();
+}
+
+%parse_failure {
+  forget_names();
+}
+
 source ::= stmts . {}
 
-stmts ::= expr . {}
-stmts ::= stmts SEMICOLON expr . {}
+stmts ::= stmt . {}
+stmts ::= stmts SEMICOLON stmt . {}
+
+stmt ::= expr . {}
+stmt ::= block_start stmts RBRACE . {
+  write_leave();
+}
+
+block_start ::= LBRACE . {
+  write_enter();
+}
 
-expr ::= STRING(name) EQ expr . {
+expr ::= NAME(name) EQ expr . {
   write_store(STORE, name.s);
 }
 expr ::= expr PLUS expr. {
@@ -75,7 +97,10 @@ expr ::= expr DIVIDE expr. {
 expr ::= NUMBER(number). {
   write_push(number.i);
 }
-expr ::= STRING(var). {
+expr ::= TEXT(text). {
+  write_text(text.s);
+}
+expr ::= NAME(var). {
   write_get(LOAD_NAME, var.s);
 }
 expr(res) ::= LPAREN expr(inside) RPAREN. {
@@ -83,35 +108,134 @@ expr(res) ::= LPAREN expr(inside) RPAREN. {
 }
 
 %code {
+  /*
+   * The names the variables are resolved by, of all the blocks the code being
+   * compiled is in, one after another (the same as the VM will have them),
+   * and where each of the blocks starts.
+   */
+  static char **names = NULL;
+  static size_t names_count = 0, names_size = 0;
+  static size_t *blocks = NULL;
+  static size_t blocks_count = 0, blocks_size = 0;
+
+  static void *grow(void *array, size_t count, size_t *size, size_t elem){
+    if (count < *size)
+      return array;
+    *size = *size ? *size * 2 : 16;
+    array = realloc(array, *size * elem);
+    if (!array){
+      fprintf(stderr, "nvm: error: failed to allocate %lu bytes\n", *size * elem);
+      exit(1);
+    }
+    return array;
+  }
+
+  /* the main block is always there */
+  static void main_block(void){
+    if (!blocks_count){
+      blocks = grow(blocks, 0, &blocks_size, sizeof(size_t));
+      blocks[blocks_count++] = 0;
+    }
+  }
+
+  /* finds the variable in the innermost block that has it, <depth> blocks out
+   * from the innermost one, and in the <slot> of that block */
+  static bool resolve(const char *name, size_t *depth, size_t *slot){
+    size_t end = names_count;
+
+    main_block();
+    for (size_t b = blocks_count; b > 0; b--){
+      for (size_t i = end; i > blocks[b - 1]; i--){
+        if (!strcmp(names[i - 1], name)){
+          *depth = blocks_count - b;
+          *slot = i - 1 - blocks[b - 1];
+          return true;
+        }
+      }
+      end = blocks[b - 1];
+    }
+
+    return false;
+  }
+
+  void forget_names(void){
+    while (names_count)
+      free(names[--names_count]);
+    blocks_count = 0;
+  }
+
+  void write_enter(void){
+    BYTE op = ENTER_BLOCK;
+    main_block();
+    blocks = grow(blocks, blocks_count, &blocks_size, sizeof(size_t));
+    blocks[blocks_count++] = names_count;
+    fwrite(&op, sizeof(op), 1, fp);
+  }
+
+  void write_leave(void){
+    BYTE op = LEAVE_BLOCK;
+    /* its variables are gone */
+    for (blocks_count--; names_count > blocks[blocks_count]; )
+      free(names[--names_count]);
+    fwrite(&op, sizeof(op), 1, fp);
+  }
+
   void write_push(int value){
     BYTE op = LOAD_CONST;
-    fwrite(&pc, sizeof(pc), 1, fp);
     fwrite(&op, sizeof(op), 1, fp);
     fwrite(&value, sizeof(value), 1, fp);
-    pc++;
+  }
+
+  void write_text(char *text){
+    BYTE op = LOAD_CONST_STRING;
+    uint32_t length = strlen(text);
+    BYTE bytes[4] = { length, length >> 8, length >> 16, length >> 24 };
+    fwrite(&op, sizeof(op), 1, fp);
+    fwrite(bytes, sizeof(bytes), 1, fp);
+    fwrite(text, length, 1, fp);
   }
 
   void write_binop(BYTE op){
-    fwrite(&pc, sizeof(pc), 1, fp);
     fwrite(&op, sizeof(op), 1, fp);
-    pc++;
   }
 
   void write_store(BYTE op, char *name){
-    size_t size = strlen(name);
-    fwrite(&pc, sizeof(pc), 1, fp);
-    fwrite(&op, sizeof(op), 1, fp);
+    size_t size = strlen(name), depth, slot;
+
+    if (!resolve(name, &depth, &slot)){
+      /* a new one, in the next slot of the innermost block */
+      depth = 0;
+      slot = names_count - blocks[blocks_count - 1];
+      names = grow(names, names_count, &names_size, sizeof(char *));
+      names[names_count] = malloc(size + 1);
+      if (!names[names_count]){
+        fprintf(stderr, "nvm: error: failed to allocate %lu bytes\n", size + 1);
+        exit(1);
+      }
+      memcpy(names[names_count++], name, size + 1);
+    }
+    /* the ones too far out for the bytes are left to the VM to find */
+    if (depth <= 0xFF && slot <= 0xFF){
+      BYTE bytes[3] = { STORE_LOCAL, depth, slot };
+      fwrite(bytes, sizeof(bytes), 1, fp);
+    } else {
+      fwrite(&op, sizeof(op), 1, fp);
+    }
     fwrite(&size, sizeof(unsigned char), 1, fp);
     fwrite(name, strlen(name) * sizeof(char), 1, fp);
-    pc++;
   }
 
   void write_get(BYTE op, char *name){
-    size_t size = strlen(name);
-    fwrite(&pc, sizeof(pc), 1, fp);
+    size_t size = strlen(name), depth, slot;
+
+    if (resolve(name, &depth, &slot) && depth <= 0xFF && slot <= 0xFF){
+      BYTE bytes[3] = { LOAD_LOCAL, depth, slot };
+      fwrite(bytes, sizeof(bytes), 1, fp);
+      return;
+    }
+    /* the VM looks for the ones the compiler doesn't know */
     fwrite(&op, sizeof(op), 1, fp);
     fwrite(&size, sizeof(unsigned char), 1, fp);
     fwrite(name, strlen(name) * sizeof(char), 1, fp);
-    pc++;
   }
 }
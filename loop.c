@@ -0,0 +1,185 @@
+/*
+ *
+ * loop.c
+ *
+ * Created at:  10/19/2026 03:40:12 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The event loop of the VMs that wait for their host functions.
+ *
+ * A host function that does I/O doesn't have to block the whole thread in it:
+ * it starts the I/O off, tells the loop which file descriptor the result comes
+ * through (`nvm_loop_await`) and returns NVM_AWAIT. That VM stops right after
+ * the CALL, with everything where it was (its stacks, the calls it's in the
+ * middle of, its coroutines), and the loop goes on with the others. Once epoll
+ * says the descriptor is ready, the `nvm_ready` finishes the host functions
+ * job, and `nvm_complete` goes on with the VM from where it stopped, until it
+ * waits for something again, or it's done.
+ *
+ * A waiting VM costs only its waiting descriptor, so there can be as many of
+ * them as there are descriptors.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "nvm.h"
+#include "loop.h"
+
+/*
+ * What a VM waits for.
+ */
+typedef struct {
+  nvm_t *vm;
+  int fd;
+  nvm_ready ready;
+  void *data;
+} watch_t;
+
+struct _nvm_loop {
+  /* the epoll instance */
+  int epfd;
+  /* number of the VMs waiting */
+  size_t watches;
+  /* called for every VM that's done */
+  nvm_finished finished;
+  void *data;
+};
+
+nvm_loop *nvm_loop_init(nvm_finished finished, void *data)
+{
+  /* {{{ nvm_loop_init body */
+  nvm_loop *loop = malloc(sizeof(nvm_loop));
+
+  if (!loop)
+    return NULL;
+
+  loop->epfd = epoll_create1(0);
+  if (loop->epfd < 0){
+    free(loop);
+    return NULL;
+  }
+  loop->watches = 0;
+  loop->finished = finished;
+  loop->data = data;
+
+  return loop;
+  /* }}} */
+}
+
+void nvm_loop_destroy(nvm_loop *loop)
+{
+  close(loop->epfd);
+  free(loop);
+}
+
+/*
+ * name:        settle
+ * description: sees what's next for the <vm> that's just stopped with the
+ *              <status>: it either waits for something new (<watches> being
+ *              the number of the waiting ones before it ran), or it's done
+ */
+static int settle(nvm_loop *loop, nvm_t *vm, int status, size_t watches)
+{
+  /* {{{ settle body */
+  /* it'd wait forever */
+  if (status == NVM_AWAITING && loop->watches == watches){
+    fprintf(stderr, "nvm: error: a host function waits, but not for the loop\n");
+    status = NVM_ERROR;
+  }
+
+  if (status != NVM_AWAITING && loop->finished)
+    loop->finished(vm, status, loop->data);
+
+  return status;
+  /* }}} */
+}
+
+int nvm_loop_start(nvm_loop *loop, nvm_t *vm)
+{
+  size_t watches = loop->watches;
+
+  return settle(loop, vm, nvm_blastoff(vm), watches);
+}
+
+int nvm_loop_await(nvm_loop *loop, nvm_t *vm, int fd, uint32_t events, nvm_ready ready, void *data)
+{
+  /* {{{ nvm_loop_await body */
+  watch_t *watch = malloc(sizeof(watch_t));
+  struct epoll_event event;
+
+  if (!watch)
+    return -1;
+
+  watch->vm = vm;
+  watch->fd = fd;
+  watch->ready = ready;
+  watch->data = data;
+
+  event.events = events;
+  event.data.ptr = watch;
+  if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &event) < 0){
+    free(watch);
+    return -1;
+  }
+
+  loop->watches++;
+
+  return 0;
+  /* }}} */
+}
+
+int nvm_loop_run(nvm_loop *loop)
+{
+  /* {{{ nvm_loop_run body */
+  struct epoll_event events[NVM_LOOP_EVENTS];
+
+  while (loop->watches){
+    int count = epoll_wait(loop->epfd, events, NVM_LOOP_EVENTS, -1);
+
+    if (count < 0){
+      /* (the profilers timer, most likely) */
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+
+    for (int i = 0; i < count; i++){
+      watch_t *watch = events[i].data.ptr;
+      nvm_t *vm = watch->vm;
+      /* the results go in place of the arguments */
+      nvm_value *args = vm->stack->base + vm->await_base;
+      int status, results;
+
+      /* it's done waiting (the ready may close the fd, so it goes first) */
+      epoll_ctl(loop->epfd, EPOLL_CTL_DEL, watch->fd, NULL);
+      size_t watches = --loop->watches;
+
+      results = watch->ready(vm, args, vm->await_argc, watch->fd, watch->data);
+      free(watch);
+
+      if (results < 0){
+        fprintf(stderr, "nvm: error: host function failed\n");
+        status = NVM_ERROR;
+      } else {
+        status = nvm_complete(vm, args, results);
+      }
+      settle(loop, vm, status, watches);
+    }
+  }
+
+  return 0;
+  /* }}} */
+}
@@ -0,0 +1,89 @@
+/*
+ *
+ * loop.h
+ *
+ * Created at:  10/19/2026 03:40:12 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * An event loop that runs any number of VMs on one thread, while their host
+ * functions wait for the file descriptors (see NVM_AWAIT).
+ */
+
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <stdint.h>
+
+#include "nvm.h"
+
+/* Number of the ready file descriptors taken at a time */
+#define NVM_LOOP_EVENTS 64
+
+/*
+ * NVM type for the event loop (see loop.c).
+ */
+typedef struct _nvm_loop nvm_loop;
+
+/*
+ * NVM type for what the loop calls once the file descriptor the host function
+ * waits for is ready. It's the rest of the host function: <args> are its
+ * <argc> arguments, still on the Main Stack, and it writes its results over
+ * them and returns how many there are (the same as `nvm_native`), or a
+ * negative number if it failed.
+ */
+typedef int (*nvm_ready)(nvm_t *vm, nvm_value *args, unsigned argc, int fd, void *data);
+
+/*
+ * NVM type for what the loop calls once the VM is done with: it ended, failed
+ * or YIELDed (its <status>, see `nvm_blastoff`), and it's off the loop.
+ */
+typedef void (*nvm_finished)(nvm_t *vm, int status, void *data);
+
+/*
+ * name:        nvm_loop_init
+ * description: creates a new event loop, which calls <finished> (with the
+ *              <data>) for every VM that's done
+ * return:      the loop, or NULL if it couldn't be created
+ */
+nvm_loop *nvm_loop_init(nvm_finished finished, void *data);
+
+/*
+ * name:        nvm_loop_destroy
+ * description: frees the loop (the VMs still waiting stay the way they are)
+ */
+void nvm_loop_destroy(nvm_loop *loop);
+
+/*
+ * name:        nvm_loop_start
+ * description: starts the <vm> off; if its host function waits for something,
+ *              the loop takes it over, otherwise it's done right away
+ * return:      the same as `nvm_blastoff`
+ */
+int nvm_loop_start(nvm_loop *loop, nvm_t *vm);
+
+/*
+ * name:        nvm_loop_await
+ * description: the host function of the <vm> waits for the <events> (the
+ *              epoll ones) on the <fd>, and once they come, the loop calls
+ *              <ready> with the <data> for its results and goes on with the
+ *              VM; called by the host function, right before it returns
+ *              NVM_AWAIT
+ * return:      0, or -1 if the fd can't be waited for
+ */
+int nvm_loop_await(nvm_loop *loop, nvm_t *vm, int fd, uint32_t events, nvm_ready ready, void *data);
+
+/*
+ * name:        nvm_loop_run
+ * description: runs the VMs on, as their file descriptors get ready, until
+ *              none of them waits for anything
+ * return:      0, or -1 if waiting failed
+ */
+int nvm_loop_run(nvm_loop *loop);
+
+#endif /* LOOP_H */
@@ -21,11 +21,18 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
 
 #include "nvm.h"
 #include "grammar.h"
+#include "profiler.h"
+#include "bigint.h"
+#include "gc.h"
+#include "str.h"
+#include "channel.h"
 
 /*
  * FOS - First On Stack
@@ -37,101 +44,1507 @@
 /* {{{ static funtion declarations */
 static void load_const(nvm_t *virtual_machine, nvm_value value);
 static nvm_value pop(nvm_t *virtual_machine);
+static void binary_op(nvm_t *virtual_machine, BYTE op);
 static void prerun(nvm_t *virtual_machine);
 static void dispatch(nvm_t *vm);
+static void execute(nvm_t *vm);
+static void call_native(nvm_t *vm, nvm_func *func);
+static void call_vector_native(nvm_t *vm, nvm_func *func);
+static void run(nvm_t *vm);
+static void run_hooked(nvm_t *vm);
+static void trace(nvm_t *vm, const char *fmt, ...);
+static void trace_insn(nvm_t *vm);
 static char *strdup(nvm_t *virtual_machine, const char *p);
 /* }}} */
 
-#if VERBOSE
-  /* to make the output nicer */
-  static unsigned shiftwidth = 1;
-# define shiftright() shiftwidth += 2
-# define shiftleft() shiftwidth -= 2
-# define print_spaces() do {\
-    unsigned counter = 0;\
-    for (; counter < shiftwidth; counter++)\
-      printf(" ");\
-  } while (0);
+/*
+ * Mnemonics of the opcodes, indexed by the opcode.
+ */
+static const char *opcode_names[OPCODES_COUNT] = {
+  [NOP]         = "nop",
+  [LOAD_CONST]  = "load_const",
+  [DISCARD]     = "discard",
+  [BINARY_ADD]  = "add",
+  [BINARY_SUB]  = "sub",
+  [BINARY_MUL]  = "mul",
+  [BINARY_DIV]  = "div",
+  [ROT_TWO]     = "rot_two",
+  [ROT_THREE]   = "rot_three",
+  [STORE]       = "store",
+  [LOAD_NAME]   = "load_name",
+  [DUP]         = "dup",
+  [FN_START]    = "fn_start",
+  [FN_END]      = "fn_end",
+  [CALL]        = "call",
+  [ENTER_BLOCK] = "enter_block",
+  [LEAVE_BLOCK] = "leave_block",
+  [LOAD_CONST_LONG]   = "load_long",
+  [LOAD_CONST_DOUBLE] = "load_double",
+  [BINARY_ADD_INT]    = "add_int",
+  [BINARY_SUB_INT]    = "sub_int",
+  [BINARY_MUL_INT]    = "mul_int",
+  [BINARY_DIV_INT]    = "div_int",
+  [BINARY_ADD_DOUBLE] = "add_double",
+  [BINARY_SUB_DOUBLE] = "sub_double",
+  [BINARY_MUL_DOUBLE] = "mul_double",
+  [BINARY_DIV_DOUBLE] = "div_double",
+  [LOAD_CONST_STRING] = "load_string",
+  [LOAD_LOCAL]        = "load_local",
+  [STORE_LOCAL]       = "store_local",
+  [TAIL_CALL]         = "tail_call",
+  [RETURN]            = "return",
+  [LOAD_ARG]          = "load_arg",
+  [STORE_ARG]         = "store_arg",
+  [YIELD]             = "yield",
+  [RESUME]            = "resume",
+  [SEND]              = "send",
+  [RECV]              = "recv",
+};
+
+#if NVM_STATS_CYCLES
+/*
+ * name:        read_cycles
+ * description: returns the current value of the time stamp counter (or the
+ *              processor time where there's no such thing)
+ */
+static inline uint64_t read_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t)hi << 32) | lo;
+#else
+  return (uint64_t)clock();
+#endif
+}
+
+/*
+ * name:        stats_bucket
+ * description: returns the histogram bucket for the given number of cycles
+ */
+static inline unsigned stats_bucket(uint64_t cycles)
+{
+  unsigned bucket = 0;
+  while (cycles >>= 1)
+    bucket++;
+  return bucket < NVM_STATS_BUCKETS ? bucket : NVM_STATS_BUCKETS - 1;
+}
+#endif
+
+/*
+ * name:        read_int
+ * description: assembles the four (little endian) bytes at <p> into an INT
+ */
+static inline INT read_int(const BYTE *p)
+{
+  return p[0] ^ (p[1] << 8) ^ (p[2] << 16) ^ ((uint32_t)p[3] << 24);
+}
+
+/*
+ * name:        read_long
+ * description: assembles the eight (little endian) bytes at <p> into an int64_t
+ */
+static inline int64_t read_long(const BYTE *p)
+{
+  return (int64_t)((uint64_t)(uint32_t)read_int(p) | (uint64_t)(uint32_t)read_int(p + 4) << 32);
+}
+
+/*
+ * name:        read_double
+ * description: the same as `read_long`, but the bytes are an IEEE 754 double
+ */
+static inline double read_double(const BYTE *p)
+{
+  int64_t bits = read_long(p);
+  double d;
+  memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+/*
+ * name:        trace
+ * description: appends the formatted text to the trace buffer, handing the
+ *              buffer over to the trace sink whenever it gets full
+ */
+static void trace(nvm_t *vm, const char *fmt, ...)
+{
+  /* {{{ trace body */
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(vm->trace_buf + vm->trace_len, NVM_TRACE_BUFFER_SIZE - vm->trace_len, fmt, ap);
+  va_end(ap);
+
+  if (len < 0)
+    return;
+
+  /* didn't fit, so flush what's there and try again */
+  if ((size_t)len >= NVM_TRACE_BUFFER_SIZE - vm->trace_len){
+    nvm_flush_trace(vm);
+    va_start(ap, fmt);
+    len = vsnprintf(vm->trace_buf, NVM_TRACE_BUFFER_SIZE, fmt, ap);
+    va_end(ap);
+    if (len < 0)
+      return;
+    /* it was truncated */
+    if ((size_t)len >= NVM_TRACE_BUFFER_SIZE)
+      len = NVM_TRACE_BUFFER_SIZE - 1;
+  }
+
+  vm->trace_len += len;
+  /* }}} */
+}
+
+/*
+ * name:        trace_insn
+ * description: traces the instruction at the current ip, indented by how deep
+ *              in calls and blocks it is
+ */
+static void trace_insn(nvm_t *vm)
+{
+  /* {{{ trace_insn body */
+  BYTE op = vm->bytes[vm->ip];
+  const BYTE *args = &vm->bytes[vm->ip + 1];
+  unsigned depth = 0;
+
+  /* every call gets a block too, and the main block doesn't count */
+  if (vm->blocks->top != vm->blocks->base)
+    depth = vm->blocks->top - vm->blocks->base - 1;
+
+  trace(vm, "%04x:%*s", vm->ip, 1 + depth * 2, "");
+
+  switch (op){
+    case LOAD_CONST:
+      trace(vm, "%s\t(%d)\n", opcode_names[op], read_int(args));
+      break;
+    case LOAD_CONST_LONG:
+      trace(vm, "%s\t(%" PRId64 ")\n", opcode_names[op], read_long(args));
+      break;
+    case LOAD_CONST_DOUBLE:
+      trace(vm, "%s\t(%g)\n", opcode_names[op], read_double(args));
+      break;
+    case LOAD_CONST_STRING:
+      /* the long ones are cut short */
+      trace(vm, "%s\t(\"%.*s\"%s)\n", opcode_names[op], read_int(args) > 32 ? 32 : read_int(args),
+          (const char *)&args[4], read_int(args) > 32 ? "..." : "");
+      break;
+    case STORE:
+    case LOAD_NAME:
+    case CALL:
+    case TAIL_CALL:
+    case RESUME:
+      trace(vm, "%s\t\t(%.*s)\n", opcode_names[op], args[0], (const char *)&args[1]);
+      break;
+    case FN_START:
+      trace(vm, "%s\t(%.*s/%u)\n", opcode_names[op], args[0], (const char *)&args[1], args[1 + args[0]]);
+      break;
+    case LOAD_ARG:
+    case STORE_ARG:
+      trace(vm, "%s\t(%u)\n", opcode_names[op], args[0]);
+      break;
+    case LOAD_LOCAL:
+      trace(vm, "%s\t(%u:%u)\n", opcode_names[op], args[0], args[1]);
+      break;
+    case STORE_LOCAL:
+      trace(vm, "%s\t(%u:%u %.*s)\n", opcode_names[op], args[0], args[1], args[2], (const char *)&args[3]);
+      break;
+    default:
+      if (op < OPCODES_COUNT)
+        trace(vm, "%s\n", opcode_names[op]);
+      else
+        trace(vm, "unknown\t\t(0x%02X)\n", op);
+      break;
+  }
+  /* }}} */
+}
+
+void nvm_set_trace(nvm_t *vm, bool on, nvm_trace_sink sink, void *data)
+{
+  /* {{{ nvm_set_trace body */
+  /* flush whatever was traced so far to the old sink */
+  nvm_flush_trace(vm);
+
+  if (on && !vm->trace_buf){
+    vm->trace_buf = vm->mallocer(NVM_TRACE_BUFFER_SIZE);
+    if (!vm->trace_buf){
+      fprintf(stderr, "nvm: error: failed to allocate %d bytes at line %d\n", NVM_TRACE_BUFFER_SIZE, __LINE__ - 2);
+      exit(1);
+    }
+  }
+
+  vm->trace      = on;
+  vm->trace_sink = sink;
+  vm->trace_data = data;
+  /* }}} */
+}
+
+void nvm_flush_trace(nvm_t *vm)
+{
+  /* {{{ nvm_flush_trace body */
+  if (!vm->trace_len)
+    return;
+
+  if (vm->trace_sink)
+    vm->trace_sink(vm->trace_data, vm->trace_buf, vm->trace_len);
+  else
+    fwrite(vm->trace_buf, 1, vm->trace_len, stdout);
+
+  vm->trace_len = 0;
+  /* }}} */
+}
+
+/*
+ * name:        fail
+ * description: reports the runtime error, and stops the execution for good
+ *              (so the host gets NVM_ERROR, and the other VMs of the process
+ *              go on)
+ */
+static void fail(nvm_t *vm, const char *fmt, ...)
+{
+  /* {{{ fail body */
+  char message[256];
+  va_list ap;
+
+  /* (in one go, so it's not mixed up with the ones of the VMs on the other
+   * threads) */
+  va_start(ap, fmt);
+  vsnprintf(message, sizeof(message), fmt, ap);
+  va_end(ap);
+  fprintf(stderr, "nvm: error: %s\n", message);
+
+  vm->failed = true;
+  vm->stopped = true;
+  /* }}} */
+}
+
+/*
+ * name:        burn
+ * description: takes the fuel of the call that's just been made, and stops
+ *              the execution if it was the last of it (right at the start of
+ *              the called body, so that's where `nvm_resume` goes on from)
+ */
+static inline void burn(nvm_t *vm)
+{
+  if (vm->fuel && !--vm->fuel){
+    vm->out_of_fuel = true;
+    vm->stopped = true;
+  }
+}
+
+/*
+ * name:        run
+ * description: executes the instructions from the current ip on, until the end
+ *              of the bytecode, or until something stops it (see `nvm_t`)
+ */
+static void run(nvm_t *vm)
+{
+  /* {{{ run body */
+  for (; vm->ip < vm->bytes_count; vm->ip++){
+    dispatch(vm);
+    if (vm->stopped)
+      break;
+  }
+  /* }}} */
+}
+
+/*
+ * name:        run_hooked
+ * description: the same as `run`, but before executing every instruction it
+ *              traces it and takes the profilers samples
+ */
+static void run_hooked(nvm_t *vm)
+{
+  /* {{{ run_hooked body */
+  for (; vm->ip < vm->bytes_count; vm->ip++){
+    if (nvm_profiler_pending)
+      nvm_profiler_sample(vm);
+    if (vm->trace)
+      trace_insn(vm);
+    dispatch(vm);
+    if (vm->stopped)
+      break;
+  }
+  /* }}} */
+}
+
+/*
+ * name:        execute
+ * description: runs the code using the loop that fits the VMs settings
+ */
+static void execute(nvm_t *vm)
+{
+  /* {{{ execute body */
+  if (vm->trace || vm->profiling)
+    run_hooked(vm);
+  else
+    run(vm);
+  /* }}} */
+}
+
+/*
+ * name:        grow_stack
+ * description: makes room for at least <count> more values on the stack
+ */
+static void grow_stack(nvm_t *vm, size_t count)
+{
+  /* {{{ grow_stack body */
+  size_t used = vm->stack->top - vm->stack->base;
+  size_t size = vm->stack->limit - vm->stack->base;
+
+  while (size - used < count)
+    size *= 2;
+
+  nvm_value *new = vm->mallocer(size * sizeof(nvm_value));
+  if (!new){
+    fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", size * sizeof(nvm_value), __LINE__ - 2);
+    exit(1);
+  }
+
+  memcpy(new, vm->stack->base, used * sizeof(nvm_value));
+  vm->freeer(vm->stack->base);
+
+  vm->stack->base  = new;
+  vm->stack->top   = new + used;
+  vm->stack->limit = new + size;
+  /* }}} */
+}
+
+/*
+ * name:        grow_locals
+ * description: makes room for one more variable in the locals
+ */
+static void grow_locals(nvm_t *vm)
+{
+  /* {{{ grow_locals body */
+  size_t used = vm->locals->top - vm->locals->base;
+  size_t size = (vm->locals->limit - vm->locals->base) * 2;
+
+  nvm_var *new = vm->mallocer(size * sizeof(nvm_var));
+  if (!new){
+    fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", size * sizeof(nvm_var), __LINE__ - 2);
+    exit(1);
+  }
+
+  memcpy(new, vm->locals->base, used * sizeof(nvm_var));
+  vm->freeer(vm->locals->base);
+
+  vm->locals->base  = new;
+  vm->locals->top   = new + used;
+  vm->locals->limit = new + size;
+  /* }}} */
+}
+
+/*
+ * name:        enter_block
+ * description: starts a new (empty) block of variables
+ */
+static void enter_block(nvm_t *vm)
+{
+  /* {{{ enter_block body */
+  if (vm->blocks->top == vm->blocks->limit){
+    size_t used = vm->blocks->top - vm->blocks->base;
+    size_t size = used * 2;
+
+    nvm_block *new = vm->mallocer(size * sizeof(nvm_block));
+    if (!new){
+      fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", size * sizeof(nvm_block), __LINE__ - 2);
+      exit(1);
+    }
+
+    memcpy(new, vm->blocks->base, used * sizeof(nvm_block));
+    vm->freeer(vm->blocks->base);
+
+    vm->blocks->base  = new;
+    vm->blocks->top   = new + used;
+    vm->blocks->limit = new + size;
+  }
+
+  vm->blocks->top->base = vm->locals->top - vm->locals->base;
+  vm->blocks->top->remembered = false;
+  vm->blocks->top++;
+  /* }}} */
+}
+
+/*
+ * name:        leave_block
+ * description: drops the innermost block, with its variables
+ */
+static inline void leave_block(nvm_t *vm)
+{
+  vm->blocks->top--;
+  vm->locals->top = vm->locals->base + vm->blocks->top->base;
+}
+
+/*
+ * name:        owner
+ * description: returns the coroutine the <block> is of: the running one, but
+ *              for the main block, which is always the main programs
+ */
+static inline nvm_coroutine *owner(nvm_t *vm, const nvm_block *block)
+{
+  return block == vm->main->blocks->base ? vm->main : vm->running;
+}
+
+/*
+ * name:        block_vars
+ * description: returns the first variable of the <block>
+ */
+static inline nvm_var *block_vars(nvm_t *vm, const nvm_block *block)
+{
+  return owner(vm, block)->locals->base + block->base;
+}
+
+/*
+ * name:        block_end
+ * description: returns one past the last variable of the <block>
+ */
+static inline nvm_var *block_end(nvm_t *vm, const nvm_block *block)
+{
+  nvm_coroutine *co = owner(vm, block);
+
+  return block + 1 == co->blocks->top ? co->locals->top : co->locals->base + block[1].base;
+}
+
+/*
+ * name:        scope
+ * description: returns the block <depth> blocks out from the innermost one
+ *              (see `nvm_block`), which is just an index into the blocks
+ */
+static inline nvm_block *scope(nvm_t *vm, BYTE depth)
+{
+  /* {{{ scope body */
+  /* the blocks of the function being run */
+  size_t own = vm->blocks->top - vm->blocks->base - vm->fn_block;
+
+  if (depth < own)
+    return vm->blocks->top - 1 - depth;
+  /* and past them, the main block */
+  if (depth == own && (vm->fn_block || vm->running != vm->main))
+    return vm->main->blocks->base;
+
+  fail(vm, "there's no block %u blocks out", depth);
+  return NULL;
+  /* }}} */
+}
+
+/*
+ * name:        find_var
+ * description: looks for the variable of that (interned) <name> in the
+ *              blocks it's seen in, the innermost one first (for the code
+ *              the compiler couldn't resolve, see LOAD_LOCAL), and stores the
+ *              block it's in at <block>
+ * return:      the variable, or NULL if there's none
+ */
+static nvm_var *find_var(nvm_t *vm, const char *name, nvm_block **block)
+{
+  /* {{{ find_var body */
+  nvm_block *fn = vm->blocks->base + vm->fn_block;
+  nvm_var *last = vm->locals->top;
+
+  /* out to the functions block */
+  for (nvm_block *b = vm->blocks->top; b != fn; b--){
+    nvm_var *first = vm->locals->base + b[-1].base;
+    for (nvm_var *p = last; p != first; p--){
+      if (p[-1].name == name){
+        *block = &b[-1];
+        return &p[-1];
+      }
+    }
+    last = first;
+  }
+
+  /* and the main block */
+  if (vm->fn_block || vm->running != vm->main){
+    nvm_block *main = vm->main->blocks->base;
+    for (nvm_var *p = block_end(vm, main); p != vm->main->locals->base; p--){
+      if (p[-1].name == name){
+        *block = main;
+        return &p[-1];
+      }
+    }
+  }
+
+  return NULL;
+  /* }}} */
+}
+
+/*
+ * name:        need
+ * description: makes sure there are at least <count> values on the stack
+ * return:      whether there are (if not, the execution is failed)
+ */
+static inline bool need(nvm_t *vm, size_t count, const char *what)
+{
+  if ((size_t)(vm->stack->top - vm->stack->base) < count){
+    fail(vm, "attempting to %s on a stack of %ld elements", what, (long)(vm->stack->top - vm->stack->base));
+    return false;
+  }
+  return true;
+}
+
+/*
+ * name:        channel
+ * description: returns the channel the <value> is, or fails the execution
+ *              (and returns NULL) if it isn't one
+ */
+static inline nvm_channel *channel(nvm_t *vm, const nvm_value *value, const char *what)
+{
+  if (value->type != CHANNEL){
+    fail(vm, "attempting to %s over something that's not a channel", what);
+    return NULL;
+  }
+  return value->as.ptr;
+}
+
+/*
+ * name:        block
+ * description: stops the execution at the SEND (if <sending>) or RECV that
+ *              has to wait for the <channel>, so `nvm_resume` does it over
+ */
+static void block(nvm_t *vm, nvm_channel *channel, bool sending)
+{
+  vm->blocked = channel;
+  vm->blocked_sending = sending;
+  vm->stopped = true;
+  /* (it moves the ip past where it stopped) */
+  vm->ip--;
+}
+
+/*
+ * name:        argument
+ * description: returns the <index>th argument of the function being run (or
+ *              NULL, and fails the execution, if there's no such argument)
+ */
+static inline nvm_value *argument(nvm_t *vm, BYTE index)
+{
+  nvm_call_frame *frame = vm->call_stack->head;
+
+  if (!frame || index >= frame->func->arity){
+    fail(vm, "there's no argument %u", index);
+    return NULL;
+  }
+
+  return &vm->stack->base[frame->base + index];
+}
+
+/*
+ * name:        drop_args
+ * description: drops the arguments of the function of the <frame>, moving
+ *              what it left on the stack above them into their place
+ */
+static void drop_args(nvm_t *vm, nvm_call_frame *frame)
+{
+  /* {{{ drop_args body */
+  nvm_value *args = vm->stack->base + frame->base;
+  nvm_value *above = args + frame->func->arity;
+
+  if (!frame->func->arity)
+    return;
+
+  /* it took them off the stack itself */
+  if (vm->stack->top <= above){
+    if (vm->stack->top > args)
+      vm->stack->top = args;
+    return;
+  }
+
+  memmove(args, above, (vm->stack->top - above) * sizeof(nvm_value));
+  vm->stack->top -= frame->func->arity;
+  /* }}} */
+}
+
+/*
+ * name:        call_native
+ * description: calls the host function, with the arguments right where they
+ *              are on the stack; the results take their place
+ */
+static void call_native(nvm_t *vm, nvm_func *func)
+{
+  /* {{{ call_native body */
+  if (!need(vm, func->arity, "call a native function"))
+    return;
+
+  /* make sure the results fit */
+  if (vm->stack->limit - vm->stack->top < NVM_NATIVE_MAX_RESULTS)
+    grow_stack(vm, NVM_NATIVE_MAX_RESULTS);
+
+  nvm_value *args = vm->stack->top - func->arity;
+  int results = func->native(vm, args, func->arity);
+
+  /* the results come later, with `nvm_complete` (so the ip stays at the
+   * CALL, and the arguments stay where they are till then) */
+  if (results == NVM_AWAIT){
+    vm->awaiting = true;
+    vm->await_base = args - vm->stack->base;
+    vm->await_argc = func->arity;
+    vm->stopped = true;
+    return;
+  }
+
+  if (results < 0 || (unsigned)results > func->arity + NVM_NATIVE_MAX_RESULTS){
+    fail(vm, "native function '%s' failed", func->name);
+    return;
+  }
+
+  vm->stack->top = args + results;
+  /* }}} */
+}
+
+/*
+ * name:        call_vector_native
+ * description: calls the vectorizable host function for the single row of
+ *              arguments that's on the stack
+ */
+static void call_vector_native(nvm_t *vm, nvm_func *func)
+{
+  /* {{{ call_vector_native body */
+  if (!need(vm, func->arity, "call a native function"))
+    return;
+
+  if (vm->stack->top == vm->stack->limit)
+    grow_stack(vm, 1);
+
+  nvm_value *args = vm->stack->top - func->arity;
+  const INT *argv[func->arity ? func->arity : 1];
+
+  for (unsigned k = 0; k < func->arity; k++){
+    if (args[k].type != INTEGER){
+      fail(vm, "native function '%s' takes only integers", func->name);
+      return;
+    }
+    argv[k] = &args[k].as.i;
+  }
+
+  int results = func->vector(vm, argv, func->arity, &args[0].as.i, 1);
+
+  if (results < 0 || results > 1){
+    fail(vm, "native function '%s' failed", func->name);
+    return;
+  }
+
+  args[0].type = INTEGER;
+  vm->stack->top = args + results;
+  /* }}} */
+}
+
+/*
+ * name:        find_func
+ * description: returns the function of that name (the one defined or
+ *              registered last, if there are more of them), or NULL
+ */
+static nvm_func *find_func(nvm_t *vm, const char *name)
+{
+  /* {{{ find_func body */
+  for (nvm_funcs_stack *p = vm->funcs; p != NULL; p = p->next)
+    if (!strcmp(name, p->func->name))
+      return p->func;
+
+  return NULL;
+  /* }}} */
+}
+
+/*
+ * name:        cache_call
+ * description: remembers that the CALL at <ip> calls <func>, so the next time
+ *              it runs it doesn't have to look for it
+ */
+static void cache_call(nvm_t *vm, int ip, nvm_func *func)
+{
+  /* {{{ cache_call body */
+  if (!vm->calls){
+    vm->calls = vm->mallocer(vm->bytes_count * sizeof(nvm_func *));
+    if (!vm->calls){
+      fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", (unsigned long)(vm->bytes_count * sizeof(nvm_func *)), __LINE__ - 2);
+      exit(1);
+    }
+    memset(vm->calls, 0, vm->bytes_count * sizeof(nvm_func *));
+  }
+
+  vm->calls[ip] = func;
+  /* }}} */
+}
+
+/*
+ * name:        forget_calls
+ * description: empties the inline caches of the CALLs (a new function could
+ *              be the one some of them call now)
+ */
+static void forget_calls(nvm_t *vm)
+{
+  /* {{{ forget_calls body */
+  if (vm->calls)
+    memset(vm->calls, 0, vm->bytes_count * sizeof(nvm_func *));
+  /* }}} */
+}
+
+/*
+ * name:        register_func
+ * description: appends the host function to the functions stack
+ */
+static int register_func(nvm_t *vm, const char *name, nvm_native native, nvm_vector_native vector, unsigned arity)
+{
+  /* {{{ register_func body */
+  nvm_func *new_func = vm->mallocer(sizeof(nvm_func));
+  nvm_funcs_stack *new_elem = vm->mallocer(sizeof(nvm_funcs_stack));
+
+  if (!new_func || !new_elem || strlen(name) > 255){
+    if (new_func)
+      vm->freeer(new_func);
+    if (new_elem)
+      vm->freeer(new_elem);
+    return -1;
+  }
+
+  new_func->name   = strdup(vm, name);
+  new_func->offset = 0;
+  new_func->native = native;
+  new_func->vector = vector;
+  new_func->arity  = arity;
+  new_func->coroutine = NULL;
+  new_elem->func   = new_func;
+  /* append that function to the functions stack */
+  new_elem->next = vm->funcs;
+  vm->funcs = new_elem;
+  /* it could be shadowing the one a CALL found before */
+  forget_calls(vm);
+
+  return 0;
+  /* }}} */
+}
+
+int nvm_register_native(nvm_t *vm, const char *name, nvm_native fn, unsigned arity)
+{
+  /* {{{ nvm_register_native body */
+  return register_func(vm, name, fn, NULL, arity);
+  /* }}} */
+}
+
+int nvm_register_vector_native(nvm_t *vm, const char *name, nvm_vector_native fn, unsigned arity)
+{
+  /* {{{ nvm_register_vector_native body */
+  return register_func(vm, name, NULL, fn, arity);
+  /* }}} */
+}
+
+/*
+ * name:        to_double
+ * description: returns the value converted to a double
+ */
+static double to_double(const nvm_value *value)
+{
+  switch (value->type){
+    case INTEGER: return value->as.i;
+    case LONG:    return (double)value->as.l;
+    case BIGINT:  return nvm_bigint_to_double(value->as.ptr);
+    default:      return value->as.d;
+  }
+}
+
+/*
+ * name:        division_by_zero
+ * description: reports the division by zero and fails the execution
+ */
+static void division_by_zero(nvm_t *vm)
+{
+  fail(vm, "division by zero");
+}
+
+/*
+ * name:        bigint_op
+ * description: does the binary op on <a> and <b> (integers of any width) as
+ *              bigints, the result (a LONG if it fits) is written over <a>
+ */
+static void bigint_op(nvm_t *vm, BYTE op, nvm_value *a, const nvm_value *b)
+{
+  /* {{{ bigint_op body */
+  /* the narrower operands are made bigints on the C stack */
+  nvm_bigint tmp_a, tmp_b;
+  uint32_t room_a[2], room_b[2];
+  const nvm_bigint *x = a->as.ptr, *y = b->as.ptr;
+  nvm_bigint *r;
+  int64_t l;
+
+  if (a->type != BIGINT){
+    nvm_bigint_set_long(&tmp_a, room_a, a->type == LONG ? a->as.l : a->as.i);
+    x = &tmp_a;
+  }
+  if (b->type != BIGINT){
+    nvm_bigint_set_long(&tmp_b, room_b, b->type == LONG ? b->as.l : b->as.i);
+    y = &tmp_b;
+  }
+
+  if (!(r = nvm_bigint_op(vm, op, x, y))){
+    division_by_zero(vm);
+    return;
+  }
+
+  if (nvm_bigint_to_long(r, &l)){
+    a->type = LONG;
+    a->as.l = l;
+  } else {
+    a->type = BIGINT;
+    a->as.ptr = r;
+  }
+
+  /* the result is on the stack now, so it's safe to collect */
+  nvm_gc_poll(vm);
+  /* }}} */
+}
+
+/*
+ * name:        binary_op
+ * description: does the binary op on the SOS and the FOS for the types (and
+ *              the overflows) the handlers' fast path doesn't cover; the
+ *              result is written over the SOS (see `nvm_value_type` for the
+ *              rules)
+ */
+static void binary_op(nvm_t *vm, BYTE op)
+{
+  /* {{{ binary_op body */
+  nvm_value *a = &vm->stack->top[-2];
+  nvm_value *b = &vm->stack->top[-1];
+
+  if (a->type == CHANNEL || b->type == CHANNEL){
+    fail(vm, "can't %s a channel", opcode_names[op]);
+    return;
+  }
+
+  if (a->type == STRING || b->type == STRING){
+    if (op != BINARY_ADD || a->type != b->type){
+      fail(vm, "can't %s a %s and a %s", opcode_names[op],
+          a->type == STRING ? "string" : "number", b->type == STRING ? "string" : "number");
+      return;
+    }
+    if (!nvm_str_concat(vm, a, b)){
+      fail(vm, "string too long (%llu bytes)", (unsigned long long)a->length + b->length);
+      return;
+    }
+    /* the result is on the stack now, so it's safe to collect */
+    nvm_gc_poll(vm);
+  } else if (a->type == DOUBLE || b->type == DOUBLE){
+    double x = to_double(a), y = to_double(b);
+
+    switch (op){
+      case BINARY_ADD: a->as.d = x + y; break;
+      case BINARY_SUB: a->as.d = x - y; break;
+      case BINARY_MUL: a->as.d = x * y; break;
+      default:         a->as.d = x / y; break;
+    }
+    a->type = DOUBLE;
+  } else if (a->type == INTEGER && b->type == INTEGER){
+    /* nothing two INTEGERs do overflows 64 bits */
+    int64_t x = a->as.i, y = b->as.i, r;
+
+    switch (op){
+      case BINARY_ADD: r = x + y; break;
+      case BINARY_SUB: r = x - y; break;
+      case BINARY_MUL: r = x * y; break;
+      default:
+        if (y == 0){
+          division_by_zero(vm);
+          return;
+        }
+        r = x / y;
+        break;
+    }
+
+    if (r >= INT32_MIN && r <= INT32_MAX){
+      a->as.i = (INT)r;
+    } else {
+      a->type = LONG;
+      a->as.l = r;
+    }
+  } else if (a->type != BIGINT && b->type != BIGINT){
+    int64_t x = a->type == LONG ? a->as.l : a->as.i;
+    int64_t y = b->type == LONG ? b->as.l : b->as.i;
+    int64_t r = 0;
+    bool overflow;
+
+    switch (op){
+      case BINARY_ADD: overflow = __builtin_add_overflow(x, y, &r); break;
+      case BINARY_SUB: overflow = __builtin_sub_overflow(x, y, &r); break;
+      case BINARY_MUL: overflow = __builtin_mul_overflow(x, y, &r); break;
+      default:
+        if (y == 0){
+          division_by_zero(vm);
+          return;
+        }
+        overflow = x == INT64_MIN && y == -1;
+        if (!overflow)
+          r = x / y;
+        break;
+    }
+
+    if (overflow){
+      bigint_op(vm, op, a, b);
+    } else {
+      a->type = LONG;
+      a->as.l = r;
+    }
+  } else {
+    bigint_op(vm, op, a, b);
+  }
+  /* }}} */
+}
+
+#if NVM_QUICKEN
+/*
+ * name:        quicken
+ * description: rewrites the generic binary op at the current ip into its
+ *              <int_op> or <double_op> variant, if both operands are of that
+ *              type and the op wasn't deoptimized before
+ */
+static inline void quicken(nvm_t *vm, BYTE int_op, BYTE double_op)
+{
+  /* {{{ quicken body */
+  nvm_value_type type = vm->stack->top[-2].type;
+
+  if (type != vm->stack->top[-1].type)
+    return;
+  /* it's polymorphic, leave it be */
+  if (vm->deopts && vm->deopts[vm->ip / 8] & (1 << vm->ip % 8))
+    return;
+
+  if (type == INTEGER)
+    vm->bytes[vm->ip] = int_op;
+  else if (type == DOUBLE)
+    vm->bytes[vm->ip] = double_op;
+  /* }}} */
+}
+#endif
+
+/*
+ * name:        deopt
+ * description: rewrites the quickened op at the current ip back into the
+ *              generic <op>, for good
+ */
+static void deopt(nvm_t *vm, BYTE op)
+{
+  /* {{{ deopt body */
+  if (!vm->deopts){
+    vm->deopts = vm->mallocer(vm->bytes_count / 8 + 1);
+    if (!vm->deopts){
+      fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", (unsigned long)vm->bytes_count / 8 + 1, __LINE__ - 2);
+      exit(1);
+    }
+    memset(vm->deopts, 0, vm->bytes_count / 8 + 1);
+  }
+
+  vm->deopts[vm->ip / 8] |= 1 << vm->ip % 8;
+  vm->bytes[vm->ip] = op;
+  /* }}} */
+}
+
+/*
+ * name:        load_const
+ * description: pushes given <value> to the stack
+ */
+static void load_const(nvm_t *vm, nvm_value value)
+{
+  /* {{{ load_const body */
+  if (vm->stack->top == vm->stack->limit)
+    grow_stack(vm, 1);
+
+  *vm->stack->top++ = value;
+  /* }}} */
+}
+
+/*
+ * name:        pop
+ * description: returns the top-most value from the stack, and reduces it's size
+ */
+static nvm_value pop(nvm_t *vm)
+{
+  /* {{{ pop body */
+  /* (the caller made sure it's not empty, see `need`) */
+  return *--vm->stack->top;
+  /* }}} */
+}
+
+/*
+ * name:        read_name
+ * description: reads the name (the length byte and the chars) next to the op
+ *              at the ip, and leaves the ip at its last byte
+ * return:      the interned name
+ */
+static const char *read_name(nvm_t *vm)
+{
+  /* {{{ read_name body */
+  BYTE length = vm->bytes[++vm->ip];
+  const char *name = nvm_str_intern(vm, (const char *)&vm->bytes[vm->ip + 1], length)->chars;
+
+  vm->ip += length;
+
+  return name;
+  /* }}} */
+}
+
+/*
+ * name:        callee
+ * description: returns the function the CALL (or RESUME) at the ip calls,
+ *              and leaves the ip at the last byte of its name
+ */
+static nvm_func *callee(nvm_t *vm)
+{
+  /* {{{ callee body */
+  /* the function this CALL found the last time it ran */
+  nvm_func *func = vm->calls ? vm->calls[vm->ip] : NULL;
+  int call_ip = vm->ip;
+
+  if (func){
+    /* just skip over the name */
+    vm->ip += 1 + vm->bytes[vm->ip + 1];
+    return func;
+  }
+
+  /* next byte to CALL byte is the functions name */
+  const char *name = read_name(vm);
+  /* search for the function */
+  func = find_func(vm, name);
+  if (!func){
+    fail(vm, "function '%s' not found", name);
+    return NULL;
+  }
+  cache_call(vm, call_ip, func);
+
+  return func;
+  /* }}} */
+}
+
+/*
+ * name:        push_frame
+ * description: makes the call of <func> from <ip> (with its arguments from
+ *              <base> up) the innermost one on the call stack
+ */
+static void push_frame(nvm_t *vm, nvm_func *func, int ip, size_t base)
+{
+  /* {{{ push_frame body */
+  /* new frame for the call */
+  nvm_call_frame *new_frame = vm->mallocer(sizeof(nvm_call_frame));
+  if (!new_frame){
+    fprintf(stderr, "nvm: error: malloc failed to allocate %lu bytes at line %d\n", sizeof(nvm_call_frame), __LINE__ - 2);
+    exit(1);
+  }
+  /* set the frames name */
+  new_frame->fn_name = func->name;
+  new_frame->func = func;
+  new_frame->ip = ip;
+  new_frame->base = base;
+  new_frame->returned = false;
+  new_frame->caller_block = vm->fn_block;
+  /* append the call frame to the call stack */
+  /*   the list is NOT empty */
+  if (vm->call_stack->head && vm->call_stack->tail){
+    new_frame->next = vm->call_stack->head->next;
+    vm->call_stack->head->next = new_frame;
+    new_frame->prev = vm->call_stack->head;
+    vm->call_stack->head = new_frame;
+  /*   appending to the empty list */
+  } else {
+    new_frame->next = vm->call_stack->head;
+    new_frame->prev = vm->call_stack->tail;
+    vm->call_stack->head = new_frame;
+    vm->call_stack->tail = new_frame;
+  }
+  /* }}} */
+}
+
+/*
+ * name:        pop_frame
+ * description: the function of the innermost frame is done, so it drops what
+ *              it left of its arguments and its blocks, and gets back to where
+ *              it was called from
+ */
+static void pop_frame(nvm_t *vm)
+{
+  /* {{{ pop_frame body */
+  nvm_call_frame *frame = vm->call_stack->head;
+  /* (a tail call could have given the frame to another function) */
+  if (!frame->returned)
+    drop_args(vm, frame);
+  /* drop the functions block (with whatever blocks it didn't leave) */
+  vm->blocks->top = vm->blocks->base + vm->fn_block + 1;
+  leave_block(vm);
+  vm->fn_block = frame->caller_block;
+  /* the caller goes on right after the call (the loop moves the ip onto the
+   * next instruction) */
+  vm->ip = frame->ip + nvm_insn_size(vm, frame->ip) - 1;
+  /* remove the call from the call stack */
+  /*   there is only one element left */
+  if (vm->call_stack->head == vm->call_stack->tail){
+    vm->freeer(vm->call_stack->head);
+    vm->call_stack->head = NULL;
+    vm->call_stack->tail = NULL;
+  /*   there is more than one element on the stack */
+  } else {
+    vm->call_stack->head->prev->next = vm->call_stack->head->next;
+    nvm_call_frame *tmp = vm->call_stack->head->prev;
+    vm->freeer(vm->call_stack->head);
+    vm->call_stack->head = tmp;
+  }
+  /* }}} */
+}
+
+/*
+ * name:        free_frames
+ * description: frees the frames of the <call_stack> (the calls that never
+ *              got to end)
+ */
+static void free_frames(nvm_t *vm, nvm_call_stack *call_stack)
+{
+  /* {{{ free_frames body */
+  nvm_call_frame *prev;
+
+  for (nvm_call_frame *p = call_stack->head; p != NULL; p = prev){
+    prev = p->prev;
+    vm->freeer(p);
+  }
+  call_stack->head = NULL;
+  call_stack->tail = NULL;
+  /* }}} */
+}
+
+void *nvm_alloc_at(nvm_t *vm, size_t size, const char *file, int line)
+{
+  /* mallocers are allowed to give NULL for 0 bytes */
+  void *p = vm->mallocer(size ? size : 1);
+  if (!p){
+    fprintf(stderr, "nvm: error: failed to allocate %lu bytes at %s:%d\n", size, file, line);
+    exit(1);
+  }
+  return p;
+}
+
+/*
+ * name:        new_coroutine
+ * description: starts the coroutine of <func>, RESUMEd at <ip>, moving its
+ *              arguments off the stack onto its own (see `nvm_coroutine`)
+ */
+static nvm_coroutine *new_coroutine(nvm_t *vm, nvm_func *func, int ip)
+{
+  /* {{{ new_coroutine body */
+  nvm_coroutine *co = nvm_alloc(vm, sizeof(nvm_coroutine));
+
+  co->stack               = nvm_alloc(vm, sizeof(nvm_stack));
+  co->stack->base         = nvm_alloc(vm, INITIAL_STACK_SIZE * sizeof(nvm_value));
+  co->stack->top          = co->stack->base;
+  co->stack->limit        = co->stack->base + INITIAL_STACK_SIZE;
+  co->locals              = nvm_alloc(vm, sizeof(nvm_locals));
+  co->locals->base        = nvm_alloc(vm, INITIAL_LOCALS_SIZE * sizeof(nvm_var));
+  co->locals->top         = co->locals->base;
+  co->locals->limit       = co->locals->base + INITIAL_LOCALS_SIZE;
+  co->blocks              = nvm_alloc(vm, sizeof(nvm_blocks_stack));
+  co->blocks->base        = nvm_alloc(vm, INITIAL_BLOCKS_SIZE * sizeof(nvm_block));
+  co->blocks->top         = co->blocks->base;
+  co->blocks->limit       = co->blocks->base + INITIAL_BLOCKS_SIZE;
+  co->call_stack          = nvm_alloc(vm, sizeof(nvm_call_stack));
+  co->call_stack->head    = NULL;
+  co->call_stack->tail    = NULL;
+  co->fn_block            = 0;
+  co->func                = func;
+  co->resumer             = NULL;
+
+  /* the arguments (there's at most 255 of them, so they fit) */
+  vm->stack->top -= func->arity;
+  memcpy(co->stack->base, vm->stack->top, func->arity * sizeof(nvm_value));
+  co->stack->top += func->arity;
+  /* its functions block */
+  co->blocks->top->base = 0;
+  co->blocks->top->remembered = false;
+  co->blocks->top++;
+  /* and the frame of the call, at the bottom of its call stack */
+  nvm_call_frame *frame = nvm_alloc(vm, sizeof(nvm_call_frame));
+  frame->fn_name          = func->name;
+  frame->func             = func;
+  frame->ip               = ip;
+  frame->base             = 0;
+  frame->returned         = false;
+  frame->caller_block     = 0;
+  frame->next             = NULL;
+  frame->prev             = NULL;
+  co->call_stack->head    = frame;
+  co->call_stack->tail    = frame;
+  /* (the loop moves it onto the first instruction of the body) */
+  co->ip = func->offset - 1;
+
+  /* right after the main program */
+  co->prev = vm->main;
+  co->next = vm->main->next;
+  if (co->next)
+    co->next->prev = co;
+  vm->main->next = co;
+  func->coroutine = co;
+
+  return co;
+  /* }}} */
+}
+
+/*
+ * name:        free_coroutine
+ * description: frees the (not running) coroutine <co>
+ */
+static void free_coroutine(nvm_t *vm, nvm_coroutine *co)
+{
+  /* {{{ free_coroutine body */
+  co->prev->next = co->next;
+  if (co->next)
+    co->next->prev = co->prev;
+  co->func->coroutine = NULL;
+
+  free_frames(vm, co->call_stack);
+  vm->freeer(co->call_stack);
+  vm->freeer(co->blocks->base);
+  vm->freeer(co->blocks);
+  vm->freeer(co->locals->base);
+  vm->freeer(co->locals);
+  vm->freeer(co->stack->base);
+  vm->freeer(co->stack);
+  vm->freeer(co);
+  /* }}} */
+}
+
+/*
+ * name:        switch_to
+ * description: suspends the running coroutine, and runs <co> from where it
+ *              stopped
+ */
+static inline void switch_to(nvm_t *vm, nvm_coroutine *co)
+{
+  /* {{{ switch_to body */
+  vm->running->ip = vm->ip;
+  vm->running->fn_block = vm->fn_block;
+
+  vm->stack      = co->stack;
+  vm->locals     = co->locals;
+  vm->blocks     = co->blocks;
+  vm->call_stack = co->call_stack;
+  vm->fn_block   = co->fn_block;
+  vm->ip         = co->ip;
+  vm->running    = co;
+  /* }}} */
+}
+
+/*
+ * name:        end_coroutine
+ * description: the function of the running coroutine is done, so it hands
+ *              over what it left on its stack to the one that resumed it, and
+ *              it's gone
+ */
+static void end_coroutine(nvm_t *vm)
+{
+  /* {{{ end_coroutine body */
+  nvm_coroutine *co = vm->running;
+
+  if (!vm->call_stack->head->returned)
+    drop_args(vm, vm->call_stack->head);
+
+  switch_to(vm, co->resumer);
+
+  size_t count = co->stack->top - co->stack->base;
+  if ((size_t)(vm->stack->limit - vm->stack->top) < count)
+    grow_stack(vm, count);
+  memcpy(vm->stack->top, co->stack->base, count * sizeof(nvm_value));
+  vm->stack->top += count;
+
+  free_coroutine(vm, co);
+  /* }}} */
+}
+
+const nvm_stats_t *nvm_stats(nvm_t *vm)
+{
+  /* {{{ nvm_stats body */
+#if NVM_STATS
+  return &vm->stats;
+#else
+  (void)vm;
+  return NULL;
+#endif
+  /* }}} */
+}
+
+void nvm_reset_stats(nvm_t *vm)
+{
+  /* {{{ nvm_reset_stats body */
+#if NVM_STATS
+  memset(&vm->stats, 0, sizeof(vm->stats));
+#else
+  (void)vm;
 #endif
+  /* }}} */
+}
 
-/*
- * name:        load_const
- * description: pushes given <value> to the stack
- */
-static void load_const(nvm_t *vm, nvm_value value)
+void nvm_print_stats(nvm_t *vm)
 {
-  /* {{{ load_const body */
-  nvm_stack_element *new = vm->mallocer(sizeof(nvm_stack_element));
-  if (!new){
-    fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", sizeof(nvm_stack_element), __LINE__ - 2);
-    exit(1);
-  }
+  /* {{{ print_stats body */
+#if NVM_STATS
+  uint64_t total = 0;
 
-  /* set its value */
-  new->value = value;
+  for (unsigned op = 0; op < OPCODES_COUNT; op++)
+    total += vm->stats.count[op];
 
-  /* appending the value to the stack */
-  /*   the stack is not empty */
-  if (vm->stack->head && vm->stack->tail){
-    new->next = vm->stack->head->next;
-    vm->stack->head->next = new;
-    new->prev = vm->stack->head;
-    vm->stack->head = new;
-  /*   the stack is empty */
-  } else {
-    new->next = vm->stack->head;
-    new->prev = vm->stack->tail;
-    vm->stack->head = new;
-    vm->stack->tail = new;
+  if (!total){
+    printf("no opcodes were executed\n");
+    return;
+  }
+
+  for (unsigned op = 0; op < OPCODES_COUNT; op++){
+    uint64_t count = vm->stats.count[op];
+    if (!count)
+      continue;
+    printf("opcode %-12s count: %10llu (%5.1f%%)", opcode_names[op],
+        (unsigned long long)count, 100.0 * count / total);
+#if NVM_STATS_CYCLES
+    printf("  cycles: %12llu (%.1f/op)", (unsigned long long)vm->stats.cycles[op],
+        (double)vm->stats.cycles[op] / count);
+#endif
+    printf("\n");
+#if NVM_STATS_CYCLES
+    for (unsigned b = 0; b < NVM_STATS_BUCKETS; b++){
+      uint64_t hits = vm->stats.histogram[op][b];
+      if (!hits)
+        continue;
+      printf("  %s%7llu cycles: %10llu |", b == NVM_STATS_BUCKETS - 1 ? ">=" : "  ",
+          1ULL << b, (unsigned long long)hits);
+      /* scale the bar to 40 columns */
+      for (uint64_t bar = 0; bar < (hits * 40 + count - 1) / count; bar++)
+        printf("#");
+      printf("\n");
+    }
+#endif
   }
+#else
+  (void)vm;
+  printf("nvm: stats are disabled (build with NVM_STATS=1)\n");
+#endif
   /* }}} */
 }
 
 /*
- * name:        pop
- * description: returns the top-most value from the stack, and reduces it's size
+ * name:        print_value
+ * description: prints the value, the way its type is printed
  */
-static nvm_value pop(nvm_t *vm)
+static void print_value(nvm_t *vm, const nvm_value *value)
 {
-  /* {{{ pop body */
-  /* check if the stack is empty */
-  if (!vm->stack->head && !vm->stack->tail){
-    fprintf(stderr, "nvm: error: attempting to pop from an empty stack\n");
-    exit(1);
-  }
-
-  nvm_value ret = vm->stack->head->value;
-
-  /* there is only one element on the stack */
-  if (vm->stack->head == vm->stack->tail){
-    nvm_stack_element *tmp = vm->stack->head;
-    free(tmp->value.ptr);
-    free(tmp);
-    vm->stack->head = vm->stack->tail = NULL;
-  /* there is more than one element on the stack */
-  } else {
-    nvm_stack_element *tmp = vm->stack->head;
-    vm->stack->head = tmp->prev;
-    vm->stack->head->next = tmp->next;
-    free(tmp->value.ptr);
-    free(tmp);
+  switch (value->type){
+    case BIGINT:
+      nvm_bigint_print(vm, value->as.ptr, stdout);
+      printf("\n");
+      break;
+    case INTEGER:
+      printf("%d\n", value->as.i);
+      break;
+    case LONG:
+      printf("%" PRId64 "\n", value->as.l);
+      break;
+    case DOUBLE:
+      printf("%g\n", value->as.d);
+      break;
+    case STRING:
+      fwrite(nvm_str_chars(value), 1, value->length, stdout);
+      printf("\n");
+      break;
+    case CHANNEL:
+      printf("channel %p\n", value->as.ptr);
+      break;
   }
-
-  return ret;
-  /* }}} */
 }
 
 void nvm_print_stack(nvm_t *vm)
 {
   /* {{{ print_stack body */
-  if (!vm->stack->head && !vm->stack->tail){
+  if (vm->stack->top == vm->stack->base){
     /* the stack is empty */
     printf("the stack is empty\n");
     return;
   }
 
-  for (nvm_stack_element *p = vm->stack->tail; p != NULL; p = p->next){
-    printf("item on stack: %d\n", *(int *)p->value.ptr);
+  for (nvm_value *p = vm->stack->base; p != vm->stack->top; p++){
+    printf("item on stack: ");
+    print_value(vm, p);
+  }
+  /* }}} */
+}
+
+void nvm_print_vars(nvm_t *vm)
+{
+  /* {{{ print_vars body */
+  nvm_var *first = vm->blocks->top != vm->blocks->base ? vm->locals->base + vm->blocks->top[-1].base : vm->locals->top;
+
+  if (first == vm->locals->top){
+    printf("there are no variables\n");
+    return;
+  }
+
+  /* the most recently defined ones first */
+  for (nvm_var *p = vm->locals->top; p != first; p--){
+    printf("variable %s: ", p[-1].name);
+    print_value(vm, &p[-1].value);
+  }
+  /* }}} */
+}
+
+off_t nvm_insn_size(nvm_t *vm, off_t i)
+{
+  /* {{{ nvm_insn_size body */
+  switch (vm->bytes[i]){
+    case LOAD_CONST:
+      return 5;
+    case LOAD_CONST_LONG:
+    case LOAD_CONST_DOUBLE:
+      return 9;
+    case LOAD_CONST_STRING:
+      return i + 4 < vm->bytes_count ? 5 + (uint32_t)read_int(&vm->bytes[i + 1]) : 5;
+    case STORE:
+    case LOAD_NAME:
+    case CALL:
+    case TAIL_CALL:
+    case RESUME:
+      return i + 1 < vm->bytes_count ? 2 + vm->bytes[i + 1] : 2;
+    case FN_START:
+      return i + 1 < vm->bytes_count ? 3 + vm->bytes[i + 1] : 3;
+    case LOAD_ARG:
+    case STORE_ARG:
+      return 2;
+    case LOAD_LOCAL:
+      return 3;
+    case STORE_LOCAL:
+      return i + 3 < vm->bytes_count ? 4 + vm->bytes[i + 3] : 4;
+    default:
+      return 1;
+  }
+  /* }}} */
+}
+
+/*
+ * name:        mark_tail_calls
+ * description: turns the CALLs that are the last thing a function does (but
+ *              leaving its blocks) into TAIL_CALLs
+ */
+static void mark_tail_calls(nvm_t *vm)
+{
+  /* {{{ mark_tail_calls body */
+  /* the last CALL, while there's been nothing but the blocks leaving after
+   * it (-1 if there's none) */
+  off_t call = -1;
+
+  for (off_t i = 3; i < vm->bytes_count; i += nvm_insn_size(vm, i)){
+    switch (vm->bytes[i]){
+      case CALL:
+        call = i;
+        break;
+      case FN_END:
+        if (call >= 0)
+          vm->bytes[call] = TAIL_CALL;
+        call = -1;
+        break;
+      case LEAVE_BLOCK:
+      case NOP:
+        break;
+      default:
+        call = -1;
+        break;
+    }
   }
   /* }}} */
 }
@@ -148,30 +1561,34 @@ static void prerun(nvm_t *vm)
   char *name;
   int i, j;
   BYTE length;
-  /* start from 3 to skip over version */
-  for (i = 3; i < vm->bytes_count; i++){
+  /* start from 3 to skip over version (and go from instruction to
+   * instruction, the arguments may have the FN_START byte in them too) */
+  for (i = 3; i < vm->bytes_count; i += nvm_insn_size(vm, i)){
     /* found a function definition */
     if (vm->bytes[i] == FN_START){
-      /* skip over FN_START */
-      i++;
-      /* get the length */
-      length = vm->bytes[i];
+      /* get the length (next to FN_START) */
+      length = vm->bytes[i + 1];
       name = vm->mallocer(length + 1);
-      /* skip over the length byte */
-      i++;
-      /* get the name */
+      /* get the name (next to the length byte) */
       for (j = 0; j < length; j++){
-        name[j] = vm->bytes[i + j];
+        name[j] = vm->bytes[i + 2 + j];
       }
       name[j] = '\0';
-      /* skip over the whole name */
-      i += length;
       /* create the function */
       nvm_func *new_func = vm->mallocer(sizeof(nvm_func));
       nvm_funcs_stack *new_elem = vm->mallocer(sizeof(nvm_funcs_stack));
-      /* set its things */
+      /* set its things (the number of arguments is past the whole name, and
+       * then the body begins) */
       new_func->name = strdup(vm, name);
-      new_func->offset = i;
+      new_func->offset = i + 3 + length;
+      new_func->native = NULL;
+      new_func->vector = NULL;
+      new_func->arity = i + 2 + length < vm->bytes_count ? vm->bytes[i + 2 + length] : 0;
+      new_func->coroutine = NULL;
+      /* find where it ends (RETURN goes there) */
+      for (new_func->end = new_func->offset; new_func->end < vm->bytes_count &&
+          vm->bytes[new_func->end] != FN_END; new_func->end += nvm_insn_size(vm, new_func->end))
+        ;
       new_elem->func = new_func;
       /* append that function to the functions stack */
       new_elem->next = vm->funcs;
@@ -181,17 +1598,32 @@ static void prerun(nvm_t *vm)
       name = NULL;
     }
   }
+
+  mark_tail_calls(vm);
+  forget_calls(vm);
   /* }}} */
 }
 
 nvm_t *nvm_init(const char *filename, void *(*mallocer)(size_t), void (*freeer)(void *))
 {
-  /* {{{ nvm_init body */
+  nvm_options options = { mallocer, freeer, 0 };
+
+  return nvm_init_opts(filename, &options);
+}
+
+nvm_t *nvm_init_opts(const char *filename, const nvm_options *options)
+{
+  /* {{{ nvm_init_opts body */
+  static const nvm_options defaults = { NULL, NULL, 0 };
+  void *(*mallocer)(size_t);
+  void (*freeer)(void *);
+
+  if (options == NULL)
+    options = &defaults;
+
   /* set the defaults for mallocer and freeer */
-  if (mallocer == NULL)
-    mallocer = malloc;
-  if (freeer == NULL)
-    freeer = free;
+  mallocer = options->mallocer ? options->mallocer : malloc;
+  freeer = options->freeer ? options->freeer : free;
 
   nvm_t *vm = mallocer(sizeof(nvm_t));
 
@@ -204,16 +1636,63 @@ nvm_t *nvm_init(const char *filename, void *(*mallocer)(size_t), void (*freeer)(
   vm->mallocer         = mallocer;
   vm->freeer           = freeer;
   vm->stack            = mallocer(sizeof(nvm_stack));
-  vm->stack->head      = NULL;
-  vm->stack->tail      = NULL;
+  vm->stack->base      = mallocer(INITIAL_STACK_SIZE * sizeof(nvm_value));
+  vm->stack->top       = vm->stack->base;
+  vm->stack->limit     = vm->stack->base + INITIAL_STACK_SIZE;
   vm->funcs            = NULL;
+  vm->locals           = mallocer(sizeof(nvm_locals));
+  vm->locals->base     = mallocer(INITIAL_LOCALS_SIZE * sizeof(nvm_var));
+  vm->locals->top      = vm->locals->base;
+  vm->locals->limit    = vm->locals->base + INITIAL_LOCALS_SIZE;
   vm->blocks           = mallocer(sizeof(nvm_blocks_stack));
-  vm->blocks->head     = NULL;
-  vm->blocks->tail     = NULL;
+  vm->blocks->base     = mallocer(INITIAL_BLOCKS_SIZE * sizeof(nvm_block));
+  vm->blocks->top      = vm->blocks->base;
+  vm->blocks->limit    = vm->blocks->base + INITIAL_BLOCKS_SIZE;
+  vm->fn_block         = 0;
   vm->call_stack       = mallocer(sizeof(nvm_call_stack));
   vm->call_stack->head = NULL;
   vm->call_stack->tail = NULL;
+  /* the stacks above are the main programs */
+  vm->main             = mallocer(sizeof(nvm_coroutine));
+  vm->main->stack      = vm->stack;
+  vm->main->locals     = vm->locals;
+  vm->main->blocks     = vm->blocks;
+  vm->main->call_stack = vm->call_stack;
+  vm->main->fn_block   = 0;
+  vm->main->ip         = 0;
+  vm->main->func       = NULL;
+  vm->main->resumer    = NULL;
+  vm->main->prev       = NULL;
+  vm->main->next       = NULL;
+  vm->running          = vm->main;
+  vm->stopped          = false;
+  vm->failed           = false;
+  vm->suspended        = false;
+  vm->yielded.type     = INTEGER;
+  vm->yielded.as.i     = 0;
+  vm->awaiting         = false;
+  vm->await_base       = 0;
+  vm->await_argc       = 0;
+  vm->fuel             = 0;
+  vm->out_of_fuel      = false;
+  vm->blocked          = NULL;
+  vm->blocked_sending  = false;
   vm->free_stack       = NULL;
+  vm->trace            = false;
+  vm->trace_sink       = NULL;
+  vm->trace_data       = NULL;
+  vm->trace_buf        = NULL;
+  vm->trace_len        = 0;
+  vm->profiling        = false;
+  vm->profiler         = NULL;
+  vm->deopts           = NULL;
+  vm->calls            = NULL;
+  vm->heap             = NULL;
+  vm->nursery_size     = options->nursery_size ? options->nursery_size : NVM_GC_NURSERY_SIZE;
+  vm->strings          = NULL;
+#if NVM_STATS
+  memset(&vm->stats, 0, sizeof(vm->stats));
+#endif
 
   /* initialize the bytes */
   /* open the file */
@@ -244,71 +1723,158 @@ void nvm_destroy(nvm_t *vm)
     vm->freeer(p);
   }
   next = NULL;
-  /* free everything on the variables stack */
-  for (nvm_vars_stack *p = vm->blocks->head->vars; p != NULL; p = next){
-    next = p->next;
-    vm->freeer(p->var);
-    vm->freeer(p);
-  }
-  next = NULL;
+  /* free the coroutines that never got to end (and the calls that didn't) */
+  while (vm->main->next)
+    free_coroutine(vm, vm->main->next);
+  free_frames(vm, vm->main->call_stack);
+  /* switch back to the main program (its stacks go below) */
+  vm->stack = vm->main->stack;
+  vm->locals = vm->main->locals;
+  vm->blocks = vm->main->blocks;
+  vm->call_stack = vm->main->call_stack;
+  vm->freeer(vm->main);
   /* free everything on the functions stack */
   for (nvm_funcs_stack *p = vm->funcs; p != NULL; p = next){
     next = p->next;
     vm->freeer(p->func);
     vm->freeer(p);
   }
-  /* free the main block */
-  vm->freeer(vm->blocks->head);
-  /* free the blocks stack */
+  /* free the blocks stack and the variables */
+  vm->freeer(vm->blocks->base);
   vm->freeer(vm->blocks);
-  next = NULL;
-  /* free the main stack */
-  for (nvm_stack_element *p = vm->stack->tail; p != NULL; p = next){
-    next = p->next;
-    vm->freeer(p);
-  }
+  vm->freeer(vm->locals->base);
+  vm->freeer(vm->locals);
   /* the main stack itself */
+  vm->freeer(vm->stack->base);
   vm->freeer(vm->stack);
+  /* stop the profiler and free its samples */
+  nvm_profiler_free(vm);
+  /* hand over what's left of the trace */
+  if (vm->trace_buf){
+    nvm_flush_trace(vm);
+    vm->freeer(vm->trace_buf);
+  }
+  /* and the whole heap (with the interned strings) */
+  nvm_str_free_all(vm);
+  nvm_gc_free_all(vm);
   /* free every other stack */
+  if (vm->deopts)
+    vm->freeer(vm->deopts);
+  if (vm->calls)
+    vm->freeer(vm->calls);
   vm->freeer(vm->bytes);
   vm->freeer(vm->call_stack);
   vm->freeer(vm);
   /* }}} */
 }
 
+/*
+ * name:        proceed
+ * description: executes the bytecode from the current ip on, until it's done
+ *              or something stops it
+ * return:      see `nvm_blastoff`
+ */
+static int proceed(nvm_t *vm)
+{
+  /* {{{ proceed body */
+  vm->stopped = false;
+  execute(vm);
+
+  if (vm->trace)
+    nvm_flush_trace(vm);
+
+  if (vm->failed)
+    return NVM_ERROR;
+  if (vm->suspended)
+    return NVM_YIELDED;
+  if (vm->awaiting)
+    return NVM_AWAITING;
+  if (vm->out_of_fuel)
+    return NVM_OUT_OF_FUEL;
+  if (vm->blocked)
+    return NVM_BLOCKED;
+
+  /* and it can't end in the middle of a function */
+  if (vm->call_stack->head){
+    fprintf(stderr, "nvm: error: unexpected end of the bytecode in function '%s'\n", vm->call_stack->head->fn_name);
+    return NVM_ERROR;
+  }
+
+  return NVM_DONE;
+  /* }}} */
+}
+
 int nvm_blastoff(nvm_t *vm)
 {
   /* {{{ nvm_blastoff body */
   /* start the pre-run (search for functions, store them, etc.) */
   prerun(vm);
 
-#if VERBOSE
-  printf("## using NVM version %u.%u.%u ##\n\n", vm->bytes[0], vm->bytes[1], vm->bytes[2]);
-#endif
+  if (vm->trace)
+    trace(vm, "## using NVM version %u.%u.%u ##\n\n", vm->bytes[0], vm->bytes[1], vm->bytes[2]);
 
   /* the main program is one big block, so create one now */
-  nvm_block *main_block = vm->mallocer(sizeof(nvm_block));
-  if (!main_block){
-    fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", sizeof(nvm_block), __LINE__ - 2);
-    exit(1);
-  }
-  /* initialize the main block */
-  main_block->vars = NULL;
-  /* append the block to the stack */
-  main_block->next = vm->blocks->head;
-  main_block->prev = vm->blocks->tail;
-  vm->blocks->head = main_block;
-  vm->blocks->tail = main_block;
+  enter_block(vm);
 
   /* and the bytecode executing itself
    *
    * we start from 3 to skip over the version
      we end   at functions offset */
-  for (vm->ip = 3; vm->ip < vm->bytes_count; vm->ip++){
-    dispatch(vm);
+  vm->ip = 3;
+
+  return proceed(vm);
+  /* }}} */
+}
+
+int nvm_resume(nvm_t *vm)
+{
+  /* {{{ nvm_resume body */
+  if (vm->awaiting){
+    fprintf(stderr, "nvm: error: the program waits for a host function, it needs its results\n");
+    return NVM_ERROR;
+  }
+  if (!vm->suspended && !vm->out_of_fuel && !vm->blocked){
+    fprintf(stderr, "nvm: error: there's nothing to resume\n");
+    return NVM_ERROR;
   }
 
-  return 0;
+  vm->suspended = false;
+  vm->out_of_fuel = false;
+  vm->blocked = NULL;
+  /* go on right after the YIELD (or the FN_START of the function it ran out
+   * of fuel calling, or right at the SEND or RECV that was blocked) */
+  vm->ip++;
+
+  return proceed(vm);
+  /* }}} */
+}
+
+void nvm_set_fuel(nvm_t *vm, uint64_t fuel)
+{
+  vm->fuel = fuel;
+}
+
+int nvm_complete(nvm_t *vm, const nvm_value *results, unsigned count)
+{
+  /* {{{ nvm_complete body */
+  if (!vm->awaiting){
+    fprintf(stderr, "nvm: error: the program doesn't wait for any host function\n");
+    return NVM_ERROR;
+  }
+  if (count > vm->await_argc + NVM_NATIVE_MAX_RESULTS){
+    fprintf(stderr, "nvm: error: too many results (%u) of a host function\n", count);
+    return NVM_ERROR;
+  }
+
+  /* (the room for them was made before the call, and they may be written
+   * over the arguments already) */
+  memmove(vm->stack->base + vm->await_base, results, count * sizeof(nvm_value));
+  vm->stack->top = vm->stack->base + vm->await_base + count;
+  vm->awaiting = false;
+  /* go on right after the CALL */
+  vm->ip++;
+
+  return proceed(vm);
   /* }}} */
 }
 
@@ -325,6 +1891,20 @@ int nvm_validate(nvm_t *vm)
         case LOAD_CONST:
           i += 4;
           break;
+        case LOAD_CONST_LONG:
+        case LOAD_CONST_DOUBLE:
+          i += 8;
+          break;
+        case LOAD_CONST_STRING:
+          /* the four bytes next to LOAD_CONST_STRING are the strings length */
+          tmp = i + 4 < vm->bytes_count ? read_int(&vm->bytes[i + 1]) : -1;
+          if (tmp < 0 || i + 4 + (off_t)tmp >= vm->bytes_count){
+            fprintf(stderr, "nvm: error: string at position 0x%02X goes past the end\n", i);
+            return -1;
+          }
+          /* skip over the length and the string */
+          i += 4 + tmp;
+          break;
         case DISCARD:
         case ROT_TWO:
         case ROT_THREE:
@@ -345,13 +1925,37 @@ int nvm_validate(nvm_t *vm)
           /* skip over the name */
           i += tmp - 1;
           break;
+        case LOAD_LOCAL:
+          /* skip over the depth and the slot */
+          i += 2;
+          break;
+        case STORE_LOCAL:
+          /* skip over the depth and the slot */
+          i += 2;
+          /* and the name, the same as for STORE */
+          tmp = vm->bytes[++i];
+          i++;
+          i += tmp - 1;
+          break;
         case DUP:
         case BINARY_ADD:
         case BINARY_SUB:
         case BINARY_MUL:
         case BINARY_DIV:
           break;
+        /* the VM only puts these there itself, but they're harmless */
+        case BINARY_ADD_INT:
+        case BINARY_SUB_INT:
+        case BINARY_MUL_INT:
+        case BINARY_DIV_INT:
+        case BINARY_ADD_DOUBLE:
+        case BINARY_SUB_DOUBLE:
+        case BINARY_MUL_DOUBLE:
+        case BINARY_DIV_DOUBLE:
+          break;
         case CALL:
+        case TAIL_CALL:
+        case RESUME:
           /* byte next to CALL is that functions name length */
           tmp = vm->bytes[++i];
           /* skip over the length byte */
@@ -364,8 +1968,20 @@ int nvm_validate(nvm_t *vm)
           tmp = vm->bytes[++i];
           /* skip over the length byte */
           i++;
-          /* skip over the name */
-          i += tmp - 1;
+          /* skip over the name, and the number of arguments */
+          i += tmp;
+          break;
+        case LOAD_ARG:
+        case STORE_ARG:
+          /* skip over the arguments index */
+          i++;
+          break;
+        case RETURN:
+          break;
+        case YIELD:
+          break;
+        case SEND:
+        case RECV:
           break;
         case FN_END:
           break;
@@ -388,423 +2004,547 @@ int nvm_validate(nvm_t *vm)
 static void dispatch(nvm_t *vm)
 {
   /* {{{ dispatch body */
-  /* an `int` is four bytes, but we're reading one byte at a time */
-  BYTE byte_one, byte_two, byte_three, byte_four;
-  /* used to retrieve variables names */
-  char *string = NULL;
-  /* additional counter */
-  int j = 0;
+  /* used to retrieve the names' lengths */
+  BYTE byte_one;
+#if NVM_STATS
+  /* the opcode being executed (the handlers move the ip) */
+  BYTE op = vm->bytes[vm->ip];
+  if (op < OPCODES_COUNT)
+    vm->stats.count[op]++;
+#if NVM_STATS_CYCLES
+  uint64_t started = read_cycles();
+#endif
+#endif
 
   switch (vm->bytes[vm->ip]){
     case NOP: {
       /* {{{ NOP body */
       /* that was tough */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("nop\n");
-#endif
       break;
       /* }}} */
     } case LOAD_CONST: {
       /* {{{ LOAD_CONST body */
       /* this is the final number which is a result of connecting the four
        * bytes that follow the LOAD_CONST byte */
-      INT integer;
-#if VERBOSE
-      printf("%04x:", vm->ip);
-#endif
-      /* extract the bytes */
-      byte_one   = vm->bytes[vm->ip + 1];
-      byte_two   = vm->bytes[vm->ip + 2];
-      byte_three = vm->bytes[vm->ip + 3];
-      byte_four  = vm->bytes[vm->ip + 4];
-      /* assemble the final number */
-      integer = byte_one ^ (byte_two << 8) ^ (byte_three << 16) ^ (byte_four << 24);
+      INT integer = read_int(&vm->bytes[vm->ip + 1]);
       /* skip over the bytes */
       vm->ip += 4;
-#if VERBOSE
-      print_spaces();
-      printf("load_const\t(%d)\n", integer);
-#endif
       nvm_value value;
-      int *new = vm->mallocer(sizeof(INT));
-      if (!new){
-        fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", sizeof(INT), __LINE__ - 2);
-        exit(1);
-      }
-      *new = integer;
-      value.ptr = new;
       value.type = INTEGER;
+      value.as.i = integer;
+      load_const(vm, value);
+      break;
+      /* }}} */
+    } case LOAD_CONST_LONG: {
+      /* {{{ LOAD_CONST_LONG body */
+      nvm_value value;
+      value.type = LONG;
+      value.as.l = read_long(&vm->bytes[vm->ip + 1]);
+      /* skip over the bytes */
+      vm->ip += 8;
+      load_const(vm, value);
+      break;
+      /* }}} */
+    } case LOAD_CONST_DOUBLE: {
+      /* {{{ LOAD_CONST_DOUBLE body */
+      nvm_value value;
+      value.type = DOUBLE;
+      value.as.d = read_double(&vm->bytes[vm->ip + 1]);
+      /* skip over the bytes */
+      vm->ip += 8;
+      load_const(vm, value);
+      break;
+      /* }}} */
+    } case LOAD_CONST_STRING: {
+      /* {{{ LOAD_CONST_STRING body */
+      nvm_value value;
+      INT length = read_int(&vm->bytes[vm->ip + 1]);
+      nvm_str_const(vm, &value, (const char *)&vm->bytes[vm->ip + 5], length);
+      /* skip over the length and the bytes */
+      vm->ip += 4 + length;
       load_const(vm, value);
       break;
       /* }}} */
     } case DISCARD: {
       /* {{{ DISCARD body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("discard\n");
-#endif
       /* check if the stack is empty */
-      if (!vm->stack->head && vm->stack->tail){
-        fprintf(stderr, "nvm: error: attempting to discard on an empty stack\n");
-        exit(1);
-      }
+      if (!need(vm, 1, "discard"))
+        break;
       /* remove it from the stack */
-      vm->stack->head->prev->next = vm->stack->head->next;
-      nvm_stack_element *tmp = vm->stack->head->prev;
-      free(vm->stack->head->value.ptr);
-      free(vm->stack->head);
-      vm->stack->head = tmp;
+      vm->stack->top--;
       break;
       /* }}} */
     } case ROT_TWO: {
       /* {{{ ROT_TWO body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("rot_two\n");
-#endif
+      if (!need(vm, 2, "rot_two"))
+        break;
       /* First on Stack */
-      nvm_value FOS = pop(vm);
-      /* Second on Stack */
-      nvm_value SOS = pop(vm);
-      /* Load'em all */
-      load_const(vm, FOS);
-      load_const(vm, SOS);
+      nvm_value FOS = vm->stack->top[-1];
+      /* swap it with the Second on Stack */
+      vm->stack->top[-1] = vm->stack->top[-2];
+      vm->stack->top[-2] = FOS;
       break;
       /* }}} */
     } case ROT_THREE: {
       /* {{{ ROT_THREE body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("rot_three\n");
-#endif
-      /* Pop'em all */
-      nvm_value FOS = pop(vm);
-      nvm_value SOS = pop(vm);
-      nvm_value TOS = pop(vm);
-      /* Load'em all */
-      load_const(vm, FOS);
-      load_const(vm, TOS);
-      load_const(vm, SOS);
+      if (!need(vm, 3, "rot_three"))
+        break;
+      /* First on Stack */
+      nvm_value FOS = vm->stack->top[-1];
+      /* lift the SOS and TOS, and put the FOS in the third position */
+      vm->stack->top[-1] = vm->stack->top[-2];
+      vm->stack->top[-2] = vm->stack->top[-3];
+      vm->stack->top[-3] = FOS;
       break;
       /* }}} */
     } case STORE: {
       /* {{{ STORE body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-#endif
-      /* byte next to STORE is that variables name length */
-      byte_one = vm->bytes[++vm->ip];
-      string = vm->mallocer(byte_one + 1);
-      if (!string){
-        fprintf(stderr, "nvm: error: failed to allocate %d bytes.\n", byte_one);
-        return;
+      if (!need(vm, 1, "store"))
+        break;
+      const char *name = read_name(vm);
+      nvm_block *block;
+      nvm_var *var = find_var(vm, name, &block);
+      /* if the variable is already there (in this block or one around it),
+       * just change its value (keeping the old one around would keep it from
+       * the garbage collector), otherwise define it in this block */
+      if (!var){
+        if (vm->locals->top == vm->locals->limit)
+          grow_locals(vm);
+        var = vm->locals->top++;
+        var->name = name;
+        block = &vm->blocks->top[-1];
       }
-      /* skip over the length byte */
-      vm->ip++;
-      /* getting the variables name, iterating through the <length> next
-       * numbers */
-      for (j = 0; j < byte_one; j++){
-        string[j] = vm->bytes[vm->ip + j];
-      }
-      string[j] = '\0';
-      /* skip over the bytes */
-      vm->ip += byte_one - 1;
-#if VERBOSE
-      print_spaces();
-      printf("store\t\t(%s)\n", string);
-#endif
-      /* create variable and its place in the list */
-      nvm_vars_stack *new_stack = vm->mallocer(sizeof(nvm_vars_stack));
-      if (!new_stack){
-        fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", sizeof(nvm_vars_stack), __LINE__ - 2);
-        exit(1);
+      var->value = pop(vm);
+      nvm_gc_write_barrier(block, &var->value);
+      break;
+      /* }}} */
+    } case STORE_LOCAL: {
+      /* {{{ STORE_LOCAL body */
+      BYTE depth = vm->bytes[vm->ip + 1];
+      nvm_block *block;
+      if (!need(vm, 1, "store") || !(block = scope(vm, depth)))
+        break;
+      nvm_var *var = block_vars(vm, block) + vm->bytes[vm->ip + 2];
+      /* skip over the depth and the slot */
+      vm->ip += 2;
+      if (var < block_end(vm, block)){
+        /* it has the name already, so just skip over it */
+        vm->ip += 1 + vm->bytes[vm->ip + 1];
+      } else if (depth == 0 && var == vm->locals->top){
+        /* the next slot of this block, so it defines the variable */
+        if (vm->locals->top == vm->locals->limit)
+          grow_locals(vm);
+        var = vm->locals->top++;
+        var->name = read_name(vm);
+      } else {
+        fail(vm, "storing to the undefined slot %u of the block %u blocks out", vm->bytes[vm->ip], depth);
+        break;
       }
-      nvm_var *new_var = vm->mallocer(sizeof(nvm_var));
-      if (!new_var){
-        fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", sizeof(nvm_var), __LINE__ - 2);
-        exit(1);
+      var->value = pop(vm);
+      nvm_gc_write_barrier(block, &var->value);
+      break;
+      /* }}} */
+    } case LOAD_LOCAL: {
+      /* {{{ LOAD_LOCAL body */
+      nvm_block *block = scope(vm, vm->bytes[vm->ip + 1]);
+      if (!block)
+        break;
+      nvm_var *var = block_vars(vm, block) + vm->bytes[vm->ip + 2];
+      if (var >= block_end(vm, block)){
+        fail(vm, "variable in the slot %u of the block %u blocks out not found",
+            vm->bytes[vm->ip + 2], vm->bytes[vm->ip + 1]);
+        break;
       }
-      /* initialize */
-      new_stack->var = new_var;
-      new_stack->var->name = strdup(vm, string);
-      new_stack->var->value = pop(vm);
-      /* append the variable to the variables list */
-      new_stack->next = vm->blocks->head->vars;
-      vm->blocks->head->vars = new_stack;
-      /* free the string */
-      vm->freeer(string);
-      string = NULL;
+      /* skip over the depth and the slot */
+      vm->ip += 2;
+      load_const(vm, var->value);
       break;
       /* }}} */
     } case LOAD_NAME: {
       /* {{{ LOAD_NAME body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-#endif
-      /* byte next to LOAD_NAME is that name's length */
-      byte_one = vm->bytes[++vm->ip];
-      string = vm->mallocer(byte_one + 1);
-
-      if (!string){
-        fprintf(stderr, "malloc: failed to allocate %d bytes.\n", byte_one);
-        return;
-      }
-
-      /* skip over the length byte */
-      vm->ip++;
-      /* getting the variables name, iterating through the <length> next
-       * numbers */
-      for (j = 0; j < byte_one; j++){
-        string[j] = vm->bytes[vm->ip + j];
-      }
-      string[j] = '\0';
-      /* skip over the bytes */
-      vm->ip += byte_one - 1;
-#if VERBOSE
-      print_spaces();
-      printf("load_name\t\t(%s)\n", string);
-#endif
-      int found = 0;
-      /* iterate through the variables list */
-      for (nvm_vars_stack *p = vm->blocks->head->vars; p != NULL; p = p->next){
-        /* we found the variable */
-        if (!strcmp(p->var->name, string)){
-          /* push its value onto the stack */
-          load_const(vm, p->var->value);
-          found = 1;
-          break;
-        }
-      }
+      const char *name = read_name(vm);
+      nvm_block *block;
+      nvm_var *var = find_var(vm, name, &block);
       /* inform if we have not found the variable */
-      if (!found){
-        fprintf(stderr, "nvm: variable '%s' not found\n", string);
-        exit(1);
+      if (!var){
+        fail(vm, "variable '%s' not found", name);
+        break;
       }
-      vm->freeer(string);
-      string = NULL;
+      /* push its value onto the stack */
+      load_const(vm, var->value);
       break;
       /* }}} */
     } case DUP: {
       /* {{{ DUP body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("dup\n");
-#endif
-      /* Pop the top-most value */
-      nvm_value FOS = pop(vm);
-      /* Put it twice to the stack */
-      load_const(vm, FOS);
-      load_const(vm, FOS);
+      if (!need(vm, 1, "dup"))
+        break;
+      /* Put the top-most value to the stack once more */
+      load_const(vm, vm->stack->top[-1]);
       break;
       /* }}} */
     } case BINARY_ADD: {
       /* {{{ BINARY_ADD body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("add\n");
+      INT result;
+      if (!need(vm, 2, "add"))
+        break;
+#if NVM_QUICKEN
+      quicken(vm, BINARY_ADD_INT, BINARY_ADD_DOUBLE);
 #endif
-      nvm_value FOS = pop(vm);
-      nvm_value SOS = pop(vm);
-      nvm_value res;
-      /* create new INT */
-      INT *new = vm->mallocer(sizeof(INT));
-      if (!new){
-        fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", sizeof(INT), __LINE__ - 2);
-        exit(1);
+      /* the result takes the place of the SOS */
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER &&
+          !__builtin_add_overflow(vm->stack->top[-2].as.i, vm->stack->top[-1].as.i, &result))
+        vm->stack->top[-2].as.i = result;
+      else
+        binary_op(vm, BINARY_ADD);
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case BINARY_ADD_INT: {
+      /* {{{ BINARY_ADD_INT body */
+      INT result;
+      if (!need(vm, 2, "add"))
+        break;
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER){
+        if (!__builtin_add_overflow(vm->stack->top[-2].as.i, vm->stack->top[-1].as.i, &result))
+          vm->stack->top[-2].as.i = result;
+        else
+          binary_op(vm, BINARY_ADD);
+      } else {
+        deopt(vm, BINARY_ADD);
+        binary_op(vm, BINARY_ADD);
+      }
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case BINARY_ADD_DOUBLE: {
+      /* {{{ BINARY_ADD_DOUBLE body */
+      if (!need(vm, 2, "add"))
+        break;
+      if (vm->stack->top[-2].type == DOUBLE && vm->stack->top[-1].type == DOUBLE){
+        vm->stack->top[-2].as.d += vm->stack->top[-1].as.d;
+      } else {
+        deopt(vm, BINARY_ADD);
+        binary_op(vm, BINARY_ADD);
       }
-      *new = *(INT *)SOS.ptr + *(INT *)FOS.ptr;
-      res.ptr = new;
-      res.type = INTEGER;
-      load_const(vm, res);
+      vm->stack->top--;
       break;
       /* }}} */
     } case BINARY_SUB: {
       /* {{{ BINARY_SUB body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("sub\n");
+      INT result;
+      if (!need(vm, 2, "sub"))
+        break;
+#if NVM_QUICKEN
+      quicken(vm, BINARY_SUB_INT, BINARY_SUB_DOUBLE);
 #endif
-      nvm_value FOS = pop(vm);
-      nvm_value SOS = pop(vm);
-      nvm_value res;
-      /* create new INT */
-      INT *new = vm->mallocer(sizeof(INT));
-      if (!new){
-        fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", sizeof(INT), __LINE__ - 2);
-        exit(1);
+      /* the result takes the place of the SOS */
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER &&
+          !__builtin_sub_overflow(vm->stack->top[-2].as.i, vm->stack->top[-1].as.i, &result))
+        vm->stack->top[-2].as.i = result;
+      else
+        binary_op(vm, BINARY_SUB);
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case BINARY_SUB_INT: {
+      /* {{{ BINARY_SUB_INT body */
+      INT result;
+      if (!need(vm, 2, "sub"))
+        break;
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER){
+        if (!__builtin_sub_overflow(vm->stack->top[-2].as.i, vm->stack->top[-1].as.i, &result))
+          vm->stack->top[-2].as.i = result;
+        else
+          binary_op(vm, BINARY_SUB);
+      } else {
+        deopt(vm, BINARY_SUB);
+        binary_op(vm, BINARY_SUB);
+      }
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case BINARY_SUB_DOUBLE: {
+      /* {{{ BINARY_SUB_DOUBLE body */
+      if (!need(vm, 2, "sub"))
+        break;
+      if (vm->stack->top[-2].type == DOUBLE && vm->stack->top[-1].type == DOUBLE){
+        vm->stack->top[-2].as.d -= vm->stack->top[-1].as.d;
+      } else {
+        deopt(vm, BINARY_SUB);
+        binary_op(vm, BINARY_SUB);
       }
-      *new = *(INT *)SOS.ptr - *(INT *)FOS.ptr;
-      res.ptr = new;
-      res.type = INTEGER;
-      load_const(vm, res);
+      vm->stack->top--;
       break;
       /* }}} */
     } case BINARY_MUL: {
       /* {{{ BINARY_MUL body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("mul\n");
+      INT result;
+      if (!need(vm, 2, "mul"))
+        break;
+#if NVM_QUICKEN
+      quicken(vm, BINARY_MUL_INT, BINARY_MUL_DOUBLE);
 #endif
-      nvm_value FOS = pop(vm);
-      nvm_value SOS = pop(vm);
-      nvm_value res;
-      /* create new INT */
-      INT *new = vm->mallocer(sizeof(INT));
-      if (!new){
-        fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", sizeof(INT), __LINE__ - 2);
-        exit(1);
+      /* the result takes the place of the SOS */
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER &&
+          !__builtin_mul_overflow(vm->stack->top[-2].as.i, vm->stack->top[-1].as.i, &result))
+        vm->stack->top[-2].as.i = result;
+      else
+        binary_op(vm, BINARY_MUL);
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case BINARY_MUL_INT: {
+      /* {{{ BINARY_MUL_INT body */
+      INT result;
+      if (!need(vm, 2, "mul"))
+        break;
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER){
+        if (!__builtin_mul_overflow(vm->stack->top[-2].as.i, vm->stack->top[-1].as.i, &result))
+          vm->stack->top[-2].as.i = result;
+        else
+          binary_op(vm, BINARY_MUL);
+      } else {
+        deopt(vm, BINARY_MUL);
+        binary_op(vm, BINARY_MUL);
+      }
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case BINARY_MUL_DOUBLE: {
+      /* {{{ BINARY_MUL_DOUBLE body */
+      if (!need(vm, 2, "mul"))
+        break;
+      if (vm->stack->top[-2].type == DOUBLE && vm->stack->top[-1].type == DOUBLE){
+        vm->stack->top[-2].as.d *= vm->stack->top[-1].as.d;
+      } else {
+        deopt(vm, BINARY_MUL);
+        binary_op(vm, BINARY_MUL);
       }
-      *new = (*(INT *)SOS.ptr) * (*(INT *)FOS.ptr);
-      res.ptr = new;
-      res.type = INTEGER;
-      load_const(vm, res);
+      vm->stack->top--;
       break;
       /* }}} */
     } case BINARY_DIV: {
       /* {{{ BINARY_DIV body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-      print_spaces();
-      printf("div\n");
+      if (!need(vm, 2, "div"))
+        break;
+#if NVM_QUICKEN
+      quicken(vm, BINARY_DIV_INT, BINARY_DIV_DOUBLE);
 #endif
-      nvm_value FOS = pop(vm);
-      nvm_value SOS = pop(vm);
-      nvm_value res;
-      /* create new INT */
-      INT *new = vm->mallocer(sizeof(INT));
-      if (!new){
-        fprintf(stderr, "nvm: malloc failed to allocate %lu bytes at line %d\n", sizeof(INT), __LINE__ - 2);
-        exit(1);
+      /* the result takes the place of the SOS (the divisors the hardware
+       * traps on are left to `binary_op`) */
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER &&
+          vm->stack->top[-1].as.i != 0 && vm->stack->top[-1].as.i != -1)
+        vm->stack->top[-2].as.i /= vm->stack->top[-1].as.i;
+      else
+        binary_op(vm, BINARY_DIV);
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case BINARY_DIV_INT: {
+      /* {{{ BINARY_DIV_INT body */
+      if (!need(vm, 2, "div"))
+        break;
+      if (vm->stack->top[-2].type == INTEGER && vm->stack->top[-1].type == INTEGER){
+        /* the divisors the hardware traps on are left to `binary_op` */
+        if (vm->stack->top[-1].as.i != 0 && vm->stack->top[-1].as.i != -1)
+          vm->stack->top[-2].as.i /= vm->stack->top[-1].as.i;
+        else
+          binary_op(vm, BINARY_DIV);
+      } else {
+        deopt(vm, BINARY_DIV);
+        binary_op(vm, BINARY_DIV);
       }
-      *new = (*(INT *)SOS.ptr) / (*(INT *)FOS.ptr);
-      res.ptr = new;
-      res.type = INTEGER;
-      load_const(vm, res);
+      vm->stack->top--;
       break;
       /* }}} */
-    } case CALL: {
-      /* {{{ CALL body */
-#if VERBOSE
-      printf("%04x:", vm->ip);
-#endif
-      /* prevent too big function calls */
-      /*if (vm->call_stack.ptr >= 700){*/
-        /*fprintf(stderr, "nvm: error: exceeded limit of function calls (700 max)\n");*/
-        /*exit(1);*/
-      /*}*/
-      /* next byte to CALL byte is the functions name */
-      byte_one = vm->bytes[++vm->ip];
-      string = vm->mallocer(byte_one + 1);
-      /* skip over the length byte */
-      vm->ip++;
-      /* get the name */
-      for (j = 0; j < byte_one; j++){
-        string[j] = vm->bytes[vm->ip + j];
+    } case BINARY_DIV_DOUBLE: {
+      /* {{{ BINARY_DIV_DOUBLE body */
+      if (!need(vm, 2, "div"))
+        break;
+      if (vm->stack->top[-2].type == DOUBLE && vm->stack->top[-1].type == DOUBLE){
+        vm->stack->top[-2].as.d /= vm->stack->top[-1].as.d;
+      } else {
+        deopt(vm, BINARY_DIV);
+        binary_op(vm, BINARY_DIV);
       }
-      string[j] = '\0';
-      /* skip over the bytes */
-      vm->ip += byte_one + 1;
-#if VERBOSE
-      print_spaces();
-      printf("call\t\t(%s)\n", string);
-#endif
-      nvm_func *func;
-      int found = 0, old_ip;
-      /* new frame for the call */
-      nvm_call_frame *new_frame = vm->mallocer(sizeof(nvm_call_frame));
-      if (!new_frame){
-        fprintf(stderr, "nvm: error: malloc failed to allocate %lu bytes at line %d\n", sizeof(nvm_call_frame), __LINE__ - 2);
-        exit(1);
+      vm->stack->top--;
+      break;
+      /* }}} */
+    } case TAIL_CALL:
+      case CALL: {
+      /* {{{ CALL body */
+      /* where the call happens (for the call frame) */
+      int call_ip = vm->ip;
+      bool tail = vm->bytes[vm->ip] == TAIL_CALL;
+      nvm_func *func = callee(vm);
+
+      if (!func)
+        break;
+
+      /* a host function does its thing right on the stack */
+      if (func->native || func->vector){
+        if (func->native)
+          call_native(vm, func);
+        else
+          call_vector_native(vm, func);
+        break;
       }
-      /* store the old variables stack */
-      nvm_vars_stack *old_vars_stack = vm->blocks->head->vars;
-      /* search for the function */
-      for (nvm_funcs_stack *p = vm->funcs; p != NULL; p = p->next){
-        /* found it */
-        if (!strcmp(string, p->func->name)){
-          func = p->func;
-          found = 1;
-          break;
-        }
+
+      if (!need(vm, func->arity, "call a function"))
+        break;
+
+      /* the caller is done, so the callee takes its frame over, instead of
+       * running in a new one (so the tail calls run in constant space) */
+      if (tail && vm->call_stack->head){
+        nvm_call_frame *frame = vm->call_stack->head;
+        /* the callers arguments go, and what's left of its blocks, and its
+         * own block starts afresh */
+        drop_args(vm, frame);
+        vm->blocks->top = vm->blocks->base + vm->fn_block + 1;
+        vm->locals->top = vm->locals->base + vm->blocks->top[-1].base;
+        frame->fn_name = func->name;
+        frame->func = func;
+        frame->base = vm->stack->top - vm->stack->base - func->arity;
+        /* (the loop moves it onto the first instruction of the body) */
+        vm->ip = func->offset - 1;
+        burn(vm);
+        break;
       }
 
-      if (!found){
-        printf("nvm: error: function '%s' not found\n", string);
-        exit(1);
+      /* the arguments stay where they are */
+      push_frame(vm, func, call_ip, vm->stack->top - vm->stack->base - func->arity);
+      /* the function gets a block of its own (so it starts with no
+       * variables, and the callers ones stay where they are, out of its
+       * scope) */
+      vm->fn_block = vm->blocks->top - vm->blocks->base;
+      enter_block(vm);
+      /* and off to its body (the loop moves it onto the first instruction,
+       * and the FN_END gets back here, see `pop_frame`) */
+      vm->ip = func->offset - 1;
+      burn(vm);
+      break;
+      /* }}} */
+    } case FN_END: {
+      /* {{{ FN_END body */
+      nvm_call_frame *frame = vm->call_stack->head;
+      /* the main program has no business running into one */
+      if (!frame){
+        fail(vm, "unexpected fn_end at position 0x%02X", vm->ip);
+        break;
+      }
+      /* the coroutines function is done, and so is the coroutine */
+      if (frame == vm->call_stack->tail && vm->running != vm->main){
+        end_coroutine(vm);
+        break;
       }
+      pop_frame(vm);
+      break;
+      /* }}} */
+    } case YIELD: {
+      /* {{{ YIELD body */
+      nvm_coroutine *co = vm->running;
+      if (!need(vm, 1, "yield"))
+        break;
+      nvm_value value = *--vm->stack->top;
+      /* the main program yields to the host (and stays right here, so
+       * `nvm_resume` moves past the YIELD) */
+      if (!co->resumer){
+        vm->yielded = value;
+        vm->suspended = true;
+        vm->stopped = true;
+        break;
+      }
+      /* the others to the one that resumed them */
+      switch_to(vm, co->resumer);
+      co->resumer = NULL;
+      load_const(vm, value);
+      break;
+      /* }}} */
+    } case RESUME: {
+      /* {{{ RESUME body */
+      int resume_ip = vm->ip;
+      nvm_func *func = callee(vm);
+      nvm_coroutine *co;
 
-      /* set the frames name */
-      new_frame->fn_name = strdup(vm, string);
-      new_frame->vars = NULL;
-      /* set the variables stack to the newly created one */
-      vm->blocks->head->vars = new_frame->vars;
-      /* store the old value of the instruction pointer */
-      old_ip = vm->ip;
-      /* set the instruction pointer to the body of the function */
-      vm->ip = func->offset;
-      /* append the call frame to the call stack */
-      /*   the list is NOT empty */
-      if (vm->call_stack->head && vm->call_stack->tail){
-        new_frame->next = vm->call_stack->head->next;
-        vm->call_stack->head->next = new_frame;
-        new_frame->prev = vm->call_stack->head;
-        vm->call_stack->head = new_frame;
-      /*   appending to the empty list */
-      } else {
-        new_frame->next = vm->call_stack->head;
-        new_frame->prev = vm->call_stack->tail;
-        vm->call_stack->head = new_frame;
-        vm->call_stack->tail = new_frame;
+      if (!func)
+        break;
+      if (func->native || func->vector){
+        fail(vm, "host function '%s' can't be resumed", func->name);
+        break;
       }
-#if VERBOSE
-      shiftright();
-#endif
-      /* execute the WHOLE body */
-      while (vm->bytes[vm->ip] != FN_END){
-        dispatch(vm);
-        vm->ip++;
+      co = func->coroutine;
+      if (!co){
+        if (!need(vm, func->arity, "start a coroutine"))
+          break;
+        co = new_coroutine(vm, func, resume_ip);
+      } else if (co->resumer){
+        fail(vm, "coroutine '%s' is running already", func->name);
+        break;
       }
-      /* restore the last position of the instruction, before calling, so it could
-       * move on with the code */
-      /* XXX, why do I have to decrement old_ip by two, to make it work? */
-      vm->ip = (old_ip -= 2);
-      /* restore the old variables stack */
-      vm->blocks->head->vars = old_vars_stack;
-      /* free the functions call stack */
-      for (nvm_vars_stack *p = new_frame->vars; p != NULL; p = p->next){
-        vm->freeer(p->var);
-        p->var = NULL;
-        vm->freeer(p);
-        p = NULL;
+      /* it goes on from where it stopped, and this one stays at the RESUME
+       * (the loop moves the ips of both past it) */
+      co->resumer = vm->running;
+      switch_to(vm, co);
+      burn(vm);
+      break;
+      /* }}} */
+    } case SEND: {
+      /* {{{ SEND body */
+      nvm_channel *chan;
+      if (!need(vm, 2, "send") || !(chan = channel(vm, &vm->stack->top[-2], "send")))
+        break;
+      if (!nvm_channel_send(chan, &vm->stack->top[-1])){
+        block(vm, chan, true);
+        break;
       }
-      /* free the string */
-      vm->freeer(string);
-      string = NULL;
-      /* remove the call from the call stack */
-      /*   there is only one element left */
-      if (vm->call_stack->head == vm->call_stack->tail){
-        vm->freeer(vm->call_stack->head);
-        vm->call_stack->head = NULL;
-        vm->call_stack->tail = NULL;
-      /*   there is more than one element on the stack */
-      } else {
-        vm->call_stack->head->prev->next = vm->call_stack->head->next;
-        nvm_call_frame *tmp = vm->call_stack->head->prev;
-        vm->freeer(vm->call_stack->head);
-        vm->call_stack->head = tmp;
+      vm->stack->top -= 2;
+      break;
+      /* }}} */
+    } case RECV: {
+      /* {{{ RECV body */
+      nvm_channel *chan;
+      if (!need(vm, 1, "recv") || !(chan = channel(vm, &vm->stack->top[-1], "recv")))
+        break;
+      if (!nvm_channel_recv(vm, chan, &vm->stack->top[-1])){
+        block(vm, chan, false);
+        break;
       }
-#if VERBOSE
-      shiftleft();
-#endif
+      /* the value is on the stack now, so it's safe to collect */
+      nvm_gc_poll(vm);
+      break;
+      /* }}} */
+    } case RETURN: {
+      /* {{{ RETURN body */
+      nvm_call_frame *frame = vm->call_stack->head;
+      if (!frame){
+        fail(vm, "trying to return, while not in a function");
+        break;
+      }
+      if (!need(vm, 1, "return"))
+        break;
+      /* the result takes the place of the arguments */
+      nvm_value result = vm->stack->top[-1];
+      vm->stack->top = vm->stack->base + frame->base;
+      *vm->stack->top++ = result;
+      frame->returned = true;
+      /* and off to the end of the body (the loop moves it onto the FN_END) */
+      vm->ip = frame->func->end - 1;
+      break;
+      /* }}} */
+    } case LOAD_ARG: {
+      /* {{{ LOAD_ARG body */
+      nvm_value *arg = argument(vm, vm->bytes[++vm->ip]);
+      if (!arg)
+        break;
+      load_const(vm, *arg);
+      break;
+      /* }}} */
+    } case STORE_ARG: {
+      /* {{{ STORE_ARG body */
+      nvm_value *arg = argument(vm, vm->bytes[++vm->ip]);
+      if (!arg || !need(vm, 1, "store"))
+        break;
+      *arg = *--vm->stack->top;
       break;
       /* }}} */
     } case FN_START: {
@@ -815,79 +2555,46 @@ static void dispatch(nvm_t *vm)
       byte_one = vm->bytes[vm->ip];
       /* skip over the length */
       vm->ip++;
-      /* skip over the name */
-      vm->ip += byte_one;
-      /* skip over the whole body */
-      while (vm->bytes[vm->ip] != FN_END)
-        vm->ip++;
+      /* skip over the name, and the number of arguments */
+      vm->ip += byte_one + 1;
+      /* skip over the whole body (instruction by instruction, the FN_END
+       * byte may be an argument too) */
+      while (vm->ip < vm->bytes_count && vm->bytes[vm->ip] != FN_END)
+        vm->ip += nvm_insn_size(vm, vm->ip);
       break;
       /* }}} */
     } case ENTER_BLOCK: {
       /* {{{ ENTER_BLOCK body */
-      nvm_block *new = vm->mallocer(sizeof(nvm_block));
-      if (!new){
-        fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", sizeof(nvm_block), __LINE__ - 2);
-        exit(1);
-      }
-      /* initialize the block */
-      new->vars = NULL;
-      /* the stack is empty */
-      if (!vm->blocks->head && !vm->blocks->tail){
-        new->next = vm->blocks->head;
-        new->prev = vm->blocks->tail;
-        vm->blocks->head = new;
-        vm->blocks->tail = new;
-      /* the stack is not empty */
-      } else {
-        new->next = vm->blocks->head->next;
-        vm->blocks->head->next = new;
-        new->prev = vm->blocks->head;
-        vm->blocks->head = new;
-      }
-#if VERBOSE
-      shiftright();
-#endif
+      enter_block(vm);
       break;
       /* }}} */
     } case LEAVE_BLOCK: {
       /* {{{ LEAVE_BLOCK body */
-      /* there are no blocks on the stack */
-      if (!vm->blocks->head && !vm->blocks->tail){
-        fprintf(stderr, "nvm: error: trying to exit from a block, while not entering into one\n");
-        exit(1);
-      }
-      /* fetch the last block on the blocks stack */
-      nvm_block *last_block = vm->blocks->head;
-      /* remove the variables that were hold in that block */
-      for (nvm_vars_stack *p = vm->blocks->head->vars; p != NULL; p = p->next){
-        vm->freeer(p->var);
-        vm->freeer(p);
+      /* the main block is there for good (and so is the functions one, until
+       * it returns) */
+      if ((size_t)(vm->blocks->top - vm->blocks->base) <= vm->fn_block + 1){
+        fail(vm, "trying to exit from a block, while not entering into one");
+        break;
       }
-      /* restore the previous variables stack to be in use */
-      vm->blocks->head->vars = last_block->prev->vars;
-      /* there is only one element on the stack */
-      if (vm->blocks->head == vm->blocks->tail){
-        free(last_block);
-        vm->blocks->head = vm->blocks->tail = NULL;
-      /* there is more than one element on the stack */
-      } else {
-        vm->blocks->head = last_block->prev;
-        vm->blocks->head->next = last_block->next;
-        free(last_block);
-      }
-#if VERBOSE
-      shiftleft();
-#endif
+      leave_block(vm);
       break;
       /* }}} */
     } default: {
       /* {{{ unknown opcode */
-      printf("nvm: error: unknown op 0x%02X at position 0x%02X\n", vm->bytes[vm->ip], vm->ip);
+      fail(vm, "unknown op 0x%02X at position 0x%02X", vm->bytes[vm->ip], vm->ip);
       /* you failed the game */
-      exit(1);
+      break;
       /* }}} */
     }
   }
+
+#if NVM_STATS && NVM_STATS_CYCLES
+  if (op < OPCODES_COUNT){
+    uint64_t spent = read_cycles() - started;
+    vm->stats.cycles[op] += spent;
+    vm->stats.histogram[op][stats_bucket(spent)]++;
+  }
+#endif
   /* }}} dispatch end */
 }
 
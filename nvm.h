@@ -6,6 +6,7 @@
 #ifndef NVM_H
 #define NVM_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <sys/types.h>
@@ -22,10 +23,98 @@
 /* Initial size of the functions stack */
 #define INITIAL_FUNCS_STACK_SIZE 30
 
+/* Initial number of values the Main Stack can hold (it grows as needed) */
+#define INITIAL_STACK_SIZE 256
+
+/* Initial number of variables the locals can hold (they grow as needed) */
+#define INITIAL_LOCALS_SIZE 64
+
+/* Initial number of nested blocks the blocks stack can hold (it grows as
+ * needed) */
+#define INITIAL_BLOCKS_SIZE 16
+
+/* Number of results a native function can push above its arguments */
+#define NVM_NATIVE_MAX_RESULTS 4
+
+/* What a native function returns to suspend the VM until its results are
+ * ready (see `nvm_complete`) */
+#define NVM_AWAIT (-128)
+
+/* Size of the buffer the trace is gathered in before handing it to the sink */
+#define NVM_TRACE_BUFFER_SIZE 4096
+
+/* Default sampling rate of the profiler (in Hz) */
+#define NVM_PROFILER_DEFAULT_HZ 1000
+
+/* Flags for `nvm_profiler_start` */
+/*   append the ip every frame is at to the functions names */
+#define NVM_PROFILE_IPS 0x01
+
+/*
+ * Per-opcode execution counters, see `nvm_stats`. When NVM_STATS_CYCLES is set
+ * too, the cycles spent in each opcode are accumulated as well (using rdtsc
+ * where available). Both compile out entirely when set to 0.
+ */
+#ifndef NVM_STATS
+#define NVM_STATS 0
+#endif
+#ifndef NVM_STATS_CYCLES
+#define NVM_STATS_CYCLES 0
+#endif
+
+/* Number of buckets in the per-opcode cycles histogram (powers of two) */
+#define NVM_STATS_BUCKETS 16
+
 /*
- * Used for verbosity/debugging purposes.
+ * SIMD kernels (SSE2, SSE4.1, AVX2 on x86) for the binary ops of the batch
+ * mode; which ones are used is picked at runtime. Set to 0 to leave only the
+ * scalar ones.
  */
-#define VERBOSE 1
+#ifndef NVM_SIMD
+#define NVM_SIMD 1
+#endif
+
+/*
+ * Quickening: the binary ops rewrite themselves into the variants specialized
+ * for the operands' types they see (see opcodes.h). Set to 0 to always run
+ * the generic ones.
+ */
+#ifndef NVM_QUICKEN
+#define NVM_QUICKEN 1
+#endif
+
+/* Number of bytes of the STRINGs that are kept right in the value */
+#define NVM_SHORT_STRING 8
+
+/* Number of rows the batch mode runs the program over at a time */
+#define NVM_BATCH_CHUNK 1024
+
+/* Default size of the nursery the new small objects are bump allocated in
+ * (see `nvm_options`) */
+#define NVM_GC_NURSERY_SIZE (256 * 1024)
+
+/* Bytes the old generation grows by before the first major garbage
+ * collection (after that, twice what was live after the last one, but never
+ * less than this) */
+#ifndef NVM_GC_INITIAL_THRESHOLD
+#define NVM_GC_INITIAL_THRESHOLD (1024 * 1024)
+#endif
+
+/* Size of the pages the garbage collected heap carves the small objects of */
+#define NVM_GC_PAGE_SIZE (64 * 1024)
+
+/* What `nvm_blastoff` and `nvm_resume` return: the program ran to its end,
+ * it failed, it YIELDed a value to the host (and waits to be resumed), it
+ * waits for the results of a host function (see `nvm_complete`), it ran out
+ * of fuel (see `nvm_set_fuel`), or it can't SEND to or RECV from a channel
+ * till another VM RECVs or SENDs (see channel.h); the last two wait to be
+ * resumed too */
+#define NVM_DONE        0
+#define NVM_ERROR       1
+#define NVM_YIELDED     2
+#define NVM_AWAITING    3
+#define NVM_OUT_OF_FUEL 4
+#define NVM_BLOCKED     5
 
 /*
  * Some handy types.
@@ -35,29 +124,110 @@ typedef int32_t INT;
 
 /*
  * NVM type for its values type.
+ *
+ * The binary ops on two values of different types work in the wider one
+ * (INTEGER < LONG < BIGINT < DOUBLE). The integer arithmetic is exact: what
+ * overflows an INTEGER becomes a LONG, and what overflows a LONG becomes a
+ * BIGINT (which turns back into a LONG whenever it fits). Integer division
+ * truncates towards zero, and dividing by zero is a runtime error. DOUBLE
+ * follows IEEE 754.
+ *
+ * A STRING is immutable, adding two of them concatenates them (and nothing
+ * else can be done with them, or with a STRING and a number).
+ *
+ * A CHANNEL carries the values from one VM to another (see channel.h), and
+ * it's only good for SENDing and RECVing.
  */
 typedef enum {
-  INTEGER
+  INTEGER,
+  LONG,
+  DOUBLE,
+  BIGINT,
+  STRING,
+  CHANNEL
 } nvm_value_type;
 
 /*
  * NVM type for its values.
  */
 typedef struct {
-  /* a pointer to the value */
-  void *ptr;
   /* type of the value */
   nvm_value_type type;
+  /* number of bytes of a STRING */
+  uint32_t length;
+  /* the value itself */
+  union {
+    /* INTEGER */
+    INT i;
+    /* LONG */
+    int64_t l;
+    /* DOUBLE */
+    double d;
+    /* a STRING of at most NVM_SHORT_STRING bytes */
+    char chars[NVM_SHORT_STRING];
+    /* a pointer to the value, for the ones that don't fit here (BIGINT
+     * points to an nvm_bigint, see bigint.h, a longer STRING to an
+     * nvm_string, see str.h, and CHANNEL to an nvm_channel, which the host
+     * owns) */
+    void *ptr;
+  } as;
 } nvm_value;
 
+/*
+ * The main type for NVM.
+ */
+typedef struct _nvm nvm_t;
+
+/*
+ * NVM type for the host (C) functions the bytecode can CALL.
+ *
+ * <args> points right at the <argc> arguments on the Main Stack (<args>[0]
+ * being the deepest one). The function writes its results over them,
+ * starting at <args>[0], and returns how many there are: at most <argc> +
+ * NVM_NATIVE_MAX_RESULTS. A negative return aborts the execution.
+ *
+ * Or it can just start off whatever it has to do (the I/O, most of the time)
+ * and return NVM_AWAIT: the VM stops right there, with the arguments on the
+ * stack, and whatever runs it goes on to something else, until the results
+ * are ready and it hands them over with `nvm_complete` (loop.h is the event
+ * loop that does all that for the file descriptors).
+ */
+typedef int (*nvm_native)(nvm_t *vm, nvm_value *args, unsigned argc);
+
+/*
+ * NVM type for the vectorizable host functions, see `nvm_run_batch`.
+ *
+ * <args> are the <argc> arguments, each an array of <rows> values (one per
+ * row); they're all INTEGERs. The function writes the <rows> results to
+ * <result> (which may be the same array as <args>[0]) and returns 1, or
+ * returns 0 if it has no result. A negative return aborts the execution.
+ */
+typedef int (*nvm_vector_native)(nvm_t *vm, const INT *const *args, unsigned argc, INT *result, size_t rows);
+
+/*
+ * NVM type for an input column of the batch mode.
+ */
+typedef struct {
+  /* name of the variable the column is bound to */
+  const char *name;
+  /* the values, one per row */
+  const INT *values;
+} nvm_column;
+
 /*
  * NVM type for its variables.
  */
 typedef struct {
-  char *name;
+  /* the name (interned, see str.h) */
+  const char *name;
   nvm_value value;
 } nvm_var;
 
+/*
+ * NVM type for its coroutines (see below).
+ */
+typedef struct _nvm_coroutine nvm_coroutine;
+
 /*
  * NVM type for its functions.
  */
@@ -66,39 +236,42 @@ typedef struct {
   char *name;
   /* where does functions body begins */
   unsigned offset;
+  /* where it ends (at its FN_END) */
+  unsigned end;
+  /* the host function (NULL for the ones defined in the bytecode) */
+  nvm_native native;
+  /* the vectorizable host function (NULL for all the others) */
+  nvm_vector_native vector;
+  /* number of arguments */
+  unsigned arity;
+  /* its suspended coroutine (NULL if it has none, see RESUME) */
+  nvm_coroutine *coroutine;
 } nvm_func;
 
-/*
- * NVM type for its Main Stack element.
- */
-typedef struct _nvm_stack_element {
-  /* value of the element */
-  nvm_value value;
-  /* a pointer to the next element on the stack list */
-  struct _nvm_stack_element *next;
-  /* a pointer to the previous element on the stack list */
-  struct _nvm_stack_element *prev;
-} nvm_stack_element;
-
 /*
  * NVM type for its Main Stack.
  */
 typedef struct {
-  /* a pointer to the first element in the stack list */
-  nvm_stack_element *head;
-  /* a pointer to the last element in the stack list */
-  nvm_stack_element *tail;
+  /* the bottom of the stack */
+  nvm_value *base;
+  /* one past the First On Stack */
+  nvm_value *top;
+  /* one past the last value the stack can hold */
+  nvm_value *limit;
 } nvm_stack;
 
 /*
- * NVM type for its variables stack.
+ * NVM type for the variables of all the blocks, one after another (every
+ * block sees its window of them, see `nvm_block`).
  */
-typedef struct _nvm_vars_stack {
-  /* a pointer to the var itself */
-  nvm_var *var;
-  /* a pointer to the next element on the list */
-  struct _nvm_vars_stack *next;
-} nvm_vars_stack;
+typedef struct {
+  /* the first variable of the main block */
+  nvm_var *base;
+  /* one past the last variable of the innermost block */
+  nvm_var *top;
+  /* one past the last variable there's room for */
+  nvm_var *limit;
+} nvm_locals;
 
 /*
  * NVM type for its functions stack.
@@ -112,12 +285,27 @@ typedef struct _nvm_funcs_stack {
 
 /*
  * NVM type for its call stack frame.
+ *
+ * The arguments are the functions first locals: they stay right where the
+ * caller pushed them on the Main Stack (starting at <base>), and the function
+ * gets them with LOAD_ARG (and STORE_ARG), they're not on its part of the
+ * stack. Once it's done, they're gone: RETURN puts its result in their place,
+ * and when it just ends (at FN_END, or calling another function in the tail
+ * position) what it left on the stack takes their place.
  */
 typedef struct _nvm_call_frame {
   /* name of the function that was called */
-  char *fn_name;
-  /* stack of local variables for the function call */
-  nvm_vars_stack *vars;
+  const char *fn_name;
+  /* the function */
+  nvm_func *func;
+  /* index of its first argument on the Main Stack */
+  size_t base;
+  /* whether it's RETURNed (so its arguments are gone already) */
+  bool returned;
+  /* index of the callers block (see `nvm_t`s fn_block) */
+  size_t caller_block;
+  /* where the function was called from (the caller goes on right after it) */
+  int ip;
   /* a pointer to the next element of a linked list */
   struct _nvm_call_frame *next;
   /* a pointer to the previous element of a linked list */
@@ -143,31 +331,141 @@ typedef struct _nvm_free_stack {
 } nvm_free_stack;
 
 /*
- * NVM type for its block.
+ * NVM type for its block (every function call gets one too). Its variables
+ * are the locals from its <base> up to the <base> of the next block (or the
+ * top of the locals, for the innermost one), so entering a block and leaving
+ * it only moves the top of the locals.
+ *
+ * The blocks are lexically scoped: the code sees the variables of its block
+ * and of the blocks around it, up to the block of the function it's in, and
+ * then the main block (not the callers ones). The blocks stack is the display
+ * LOAD_LOCAL and STORE_LOCAL index: depth 0 is the innermost block, depth 1
+ * the one around it, and so on, the depth one past the functions block being
+ * the main block.
  */
-typedef struct _nvm_block {
-  /* stack of variables for that block */
-  nvm_vars_stack *vars;
-  /* pointer to the next element on the stack */
-  struct _nvm_block *next;
-  /* pointer to the previous element on the stack */
-  struct _nvm_block *prev;
+typedef struct {
+  /* index of the first of its variables in the locals */
+  size_t base;
+  /* whether the write barrier remembered its variables (see gc.h) */
+  bool remembered;
 } nvm_block;
 
 /*
  * NVM type for its stack holding blocks.
  */
 typedef struct {
-  /* a pointer to the first block on the stack */
-  nvm_block *head;
-  /* a pointer to the last block on the stack */
-  nvm_block *tail;
+  /* the main block */
+  nvm_block *base;
+  /* one past the innermost block */
+  nvm_block *top;
+  /* one past the last block there's room for */
+  nvm_block *limit;
 } nvm_blocks_stack;
 
 /*
- * The main type for NVM.
+ * NVM type for a coroutine: the main program, or a function that was RESUMEd.
+ * It can stop in the middle, with YIELD, however deep down its calls it is,
+ * and go on later from where it stopped. Each one has a Main Stack, variables,
+ * blocks and call stack of its own, which stay put while it's suspended, so
+ * switching from one to another only swaps the pointers to them (the VM keeps
+ * the ones of the running coroutine at hand, in the `nvm_t`).
+ *
+ * The functions they run see the main programs main block, like all the
+ * others do.
+ */
+struct _nvm_coroutine {
+  nvm_stack *stack;
+  nvm_locals *locals;
+  nvm_blocks_stack *blocks;
+  nvm_call_stack *call_stack;
+  /* index of the block of the function being run in its blocks (0 is its
+   * functions block, or the main block of the main program) */
+  size_t fn_block;
+  /* where it stopped (at its YIELD, or at the RESUME of another one) */
+  int ip;
+  /* the function (NULL for the main program) */
+  nvm_func *func;
+  /* the one that RESUMEd it, and gets what it yields (NULL while it's
+   * suspended, and for the main program, which yields to the host) */
+  nvm_coroutine *resumer;
+  /* the other coroutines (the main program first) */
+  nvm_coroutine *prev;
+  nvm_coroutine *next;
+};
+
+/*
+ * NVM type for the function that receives the trace, see `nvm_set_trace`.
+ *
+ * <data> is whatever was given to `nvm_set_trace`, <buf> holds <len> bytes of
+ * the trace (not NUL terminated).
+ */
+typedef void (*nvm_trace_sink)(void *data, const char *buf, size_t len);
+
+/*
+ * NVM type for its sampling profiler (see profiler.c).
+ */
+typedef struct _nvm_profiler nvm_profiler;
+
+/*
+ * NVM type for its garbage collected heap (see gc.c).
+ */
+typedef struct _nvm_heap nvm_heap;
+
+/*
+ * NVM type for its table of the interned strings (see str.c).
+ */
+typedef struct _nvm_strings nvm_strings;
+
+/*
+ * NVM type for the channels between the VMs (see channel.c).
+ */
+typedef struct _nvm_channel nvm_channel;
+
+/*
+ * NVM type for the garbage collectors statistics.
  */
 typedef struct {
+  /* number of major collections so far */
+  uint64_t collections;
+  /* number of minor collections so far */
+  uint64_t minor_collections;
+  /* bytes allocated so far */
+  uint64_t allocated;
+  /* bytes freed so far */
+  uint64_t freed;
+  /* bytes copied from the nursery to the old generation so far */
+  uint64_t promoted;
+  /* bytes of the old generation that were live after the last major
+   * collection */
+  uint64_t live;
+} nvm_gc_stats_t;
+
+/*
+ * NVM type for the options of `nvm_init_opts`, the zeroed ones get the
+ * defaults.
+ */
+typedef struct {
+  /* the allocating and freeing functions (malloc and free) */
+  void *(*mallocer)(size_t);
+  void (*freeer)(void *);
+  /* size of the garbage collectors nursery (NVM_GC_NURSERY_SIZE) */
+  size_t nursery_size;
+} nvm_options;
+
+/*
+ * NVM type for its per-opcode execution statistics.
+ */
+typedef struct {
+  /* how many times each opcode was executed */
+  uint64_t count[OPCODES_COUNT];
+  /* total cycles spent in each opcode (zeros without NVM_STATS_CYCLES) */
+  uint64_t cycles[OPCODES_COUNT];
+  /* histogram of cycles per single execution, bucket N holds the executions
+   * that took [2^N, 2^(N+1)) cycles, the last one holds everything above */
+  uint64_t histogram[OPCODES_COUNT][NVM_STATS_BUCKETS];
+} nvm_stats_t;
+
+struct _nvm {
   /* Files name */
   const char *filename;
   /* contents of the file */
@@ -182,17 +480,83 @@ typedef struct {
   int ip;
   /* The Stack */
   nvm_stack *stack;
-  /* pointer to the first element of the variables stack */
-  nvm_vars_stack *vars;
+  /* the variables of the blocks */
+  nvm_locals *locals;
   /* pointer to the first element of the functions stack */
   nvm_funcs_stack *funcs;
   /* pointer to the blocks stack */
   nvm_blocks_stack *blocks;
+  /* index of the block of the function being run (0, the main block, outside
+   * of the functions) */
+  size_t fn_block;
   /* call stack, every function call goes here */
   nvm_call_stack *call_stack;
+  /* the coroutine being run (the stacks above are its) */
+  nvm_coroutine *running;
+  /* the main programs coroutine, followed by all the others */
+  nvm_coroutine *main;
+  /* whether the execution has to stop where it is (at a YIELD to the host,
+   * a host function that awaits, running out of fuel, a channel it has to
+   * wait for, or a runtime error) */
+  bool stopped;
+  /* whether it was stopped for a runtime error (it can't go on after that,
+   * it can only be destroyed) */
+  bool failed;
+  /* whether the main program YIELDed to the host, and waits to be resumed */
+  bool suspended;
+  /* what it YIELDed (only good until it's resumed, the garbage collector may
+   * move it afterwards) */
+  nvm_value yielded;
+  /* whether it waits for the results of a host function (see `nvm_native`) */
+  bool awaiting;
+  /* index of the first of its arguments on the Main Stack, where its
+   * results go, and the number of the arguments */
+  size_t await_base;
+  unsigned await_argc;
+  /* number of the calls it can make before it's stopped, 0 for no limit
+   * (see `nvm_set_fuel`) */
+  uint64_t fuel;
+  /* whether it was stopped for running out of it */
+  bool out_of_fuel;
+  /* the channel it waits for (NULL if none), and whether it waits to SEND
+   * to it (or to RECV from it) */
+  nvm_channel *blocked;
+  bool blocked_sending;
   /* pointer to the first element of free stack (with things to be free'd) */
   nvm_free_stack *free_stack;
-} nvm_t;
+  /* whether every executed instruction is traced */
+  bool trace;
+  /* where the trace goes to (if NULL, goes to stdout) */
+  nvm_trace_sink trace_sink;
+  /* passed along to the trace sink */
+  void *trace_data;
+  /* the trace gathered so far */
+  char *trace_buf;
+  /* number of bytes in the trace buffer */
+  size_t trace_len;
+  /* whether the profiler is running */
+  bool profiling;
+  /* the profilers samples (NULL if it was never started) */
+  nvm_profiler *profiler;
+  /* the heap of the values that don't fit in the nvm_value (NULL until the
+   * first one is allocated) */
+  nvm_heap *heap;
+  /* size of the heaps nursery */
+  size_t nursery_size;
+  /* the interned strings (NULL until the first one is interned) */
+  nvm_strings *strings;
+  /* one bit per byte of the bytecode, set for the ops that were quickened
+   * and had to go back to the generic ones (NULL until it first happens) */
+  BYTE *deopts;
+  /* the inline caches of the CALLs: the function the CALL at each byte of the
+   * bytecode found the last time it ran (NULL until the first call, and for
+   * the ones that haven't run yet) */
+  nvm_func **calls;
+#if NVM_STATS
+  /* per-opcode execution statistics */
+  nvm_stats_t stats;
+#endif
+};
 
 /*
  * name:        nvm_init
@@ -212,14 +576,69 @@ typedef struct {
  */
 nvm_t *nvm_init(const char *filename, void *(*malloccer)(size_t), void (*freeer)(void *));
 
+/*
+ * name:        nvm_init_opts
+ * description: like `nvm_init`, with the <options> (or the defaults, if NULL)
+ */
+nvm_t *nvm_init_opts(const char *filename, const nvm_options *options);
+
 /*
  * name:        nvm_blastoff
  * description: starts off the executing progress
- * return:      0 if everything went OK
- *              1 if not
+ * return:      NVM_DONE if everything went OK
+ *              NVM_ERROR if not (a runtime error, like a division by zero,
+ *              only stops this VM, which can't go on after that)
+ *              NVM_YIELDED if the program YIELDed (the value is in the
+ *              `yielded` of the <vm>), see `nvm_resume`
+ *              NVM_AWAITING if it waits for a host function, see
+ *              `nvm_complete`
+ *              NVM_OUT_OF_FUEL if it ran out of fuel, see `nvm_set_fuel`
+ *              NVM_BLOCKED if it waits for a channel (the `blocked` of the
+ *              <vm>), see `nvm_resume` and `nvm_channel_park`
  */
 int nvm_blastoff(nvm_t *vm);
 
+/*
+ * name:        nvm_resume
+ * description: goes on with the program that YIELDed, right after the YIELD
+ *              (with all its calls and coroutines the way they were), until
+ *              it yields again or ends; so the host can take the values one
+ *              by one, as the program comes up with them:
+ *
+ *                for (s = nvm_blastoff(vm); s == NVM_YIELDED; s = nvm_resume(vm))
+ *                  consume(&vm->yielded);
+ *
+ *              the same goes for the program that ran out of fuel (which goes
+ *              on from the start of the function it was calling), and the
+ *              one blocked on a channel (which tries again)
+ * return:      the same as `nvm_blastoff`, or NVM_ERROR if the program isn't
+ *              suspended
+ */
+int nvm_resume(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_complete
+ * description: hands over the <count> <results> of the host function the
+ *              program waits for (which take the place of its arguments, the
+ *              same as if it returned them), and goes on with the program
+ *              right after its CALL
+ * return:      the same as `nvm_blastoff`, or NVM_ERROR if the program doesn't
+ *              wait for any, or there's too many results
+ */
+int nvm_complete(nvm_t *virtual_machine, const nvm_value *results, unsigned count);
+
+/*
+ * name:        nvm_set_fuel
+ * description: lets the program make <fuel> more calls (CALLs and RESUMEs of
+ *              the bytecode functions), 0 for as many as it wants; it's
+ *              stopped right as it makes the last one, with NVM_OUT_OF_FUEL,
+ *              so it can't keep the host busy for longer than that (there's
+ *              no jumps, so it's only the calls that can run it on and on),
+ *              and the host can go on with it later (with more, or with no
+ *              limit if it doesn't set any), or let it be
+ */
+void nvm_set_fuel(nvm_t *virtual_machine, uint64_t fuel);
+
 /*
  * name:        nvm_destroy
  * description: cleans up after everything (which includes fclosing the file and
@@ -237,10 +656,190 @@ void nvm_destroy(nvm_t *virtual_machine);
  */
 int nvm_validate(nvm_t *virtual_machine);
 
+/*
+ * name:        nvm_insn_size
+ * description: tells how many bytes the instruction at <i> takes (with its
+ *              arguments), for stepping over the bytecode
+ */
+off_t nvm_insn_size(nvm_t *virtual_machine, off_t i);
+
+/*
+ * name:        nvm_alloc
+ * description: allocates <size> bytes with the mallocer of the VM; the VM has
+ *              no way to go on without them, so if that fails it tells which
+ *              <file> and <line> wanted them (`nvm_alloc` passes the caller's)
+ *              and exits
+ */
+void *nvm_alloc_at(nvm_t *virtual_machine, size_t size, const char *file, int line);
+#define nvm_alloc(vm, size) nvm_alloc_at((vm), (size), __FILE__, __LINE__)
+
+/*
+ * name:        nvm_register_native
+ * description: makes the host function <fn> callable from the bytecode (with
+ *              CALL <name>), see `nvm_native`; functions defined in the
+ *              bytecode with the same name take precedence
+ *
+ * parameters:
+ *
+ *        name: name of the function
+ *          fn: the host function
+ *       arity: number of arguments it takes from the stack
+ *
+ * return:       0 - the function was registered
+ *              -1 - it wasn't (allocation failed or the name is too long)
+ */
+int nvm_register_native(nvm_t *virtual_machine, const char *name, nvm_native fn, unsigned arity);
+
+/*
+ * name:        nvm_register_vector_native
+ * description: the same as `nvm_register_native`, but for a vectorizable
+ *              function, see `nvm_vector_native`; the batch mode calls it once
+ *              for all the rows, the usual mode once for every call (with
+ *              a single row)
+ */
+int nvm_register_vector_native(nvm_t *virtual_machine, const char *name, nvm_vector_native fn, unsigned arity);
+
+/*
+ * name:        nvm_run_batch
+ * description: evaluates the program over <rows> rows at once (see batch.c),
+ *              the variables the program loads are the <inputs> columns; only
+ *              straight-line code is supported (no blocks and no calls of the
+ *              functions defined in the bytecode); the rows are gone through
+ *              NVM_BATCH_CHUNK at a time
+ *
+ * parameters:
+ *
+ *      inputs: the input columns
+ *       count: number of them
+ *        rows: number of rows in every column
+ *      output: where the <rows> values the program leaves as the FOS go
+ *
+ * return:       0 - everything went OK
+ *              -1 - there's an instruction the batch mode doesn't support, a
+ *                   native function failed (or gave a result that's not an
+ *                   INTEGER), there was a division by zero, or
+ *                   a result didn't fit in an INTEGER (it only does INTEGERs,
+ *                   so where the interpreter would go on with a LONG, it
+ *                   stops)
+ *              -2 - there's an unknown variable
+ *              -3 - the stack had too few elements
+ */
+int nvm_run_batch(nvm_t *virtual_machine, const nvm_column *inputs, unsigned count, size_t rows, INT *output);
+
+/*
+ * name:        nvm_batch_kernels
+ * description: tells which kernels the batch mode does the binary ops with
+ * return:      "avx2", "sse4.1", "sse2" or "scalar"
+ */
+const char *nvm_batch_kernels(void);
+
+/*
+ * name:        nvm_use_batch_kernels
+ * description: makes the batch mode use the given kernels (the best ones the
+ *              CPU supports are used by default)
+ * return:      0 - OK
+ *             -1 - they're unknown, or unsupported by the CPU (or the build)
+ */
+int nvm_use_batch_kernels(const char *name);
+
 /*
  * name:        nvm_print_stack
  * description: prints what's left on stack
  */
 void nvm_print_stack(nvm_t *virtual_machine);
 
+/*
+ * name:        nvm_print_vars
+ * description: prints the variables of the current block (the most recently
+ *              defined ones first)
+ */
+void nvm_print_vars(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_set_trace
+ * description: turns the tracing of every executed instruction on or off;
+ *              with the tracing off the VM runs a loop that does no tracing at
+ *              all
+ *
+ * parameters:
+ *
+ *          on: whether to trace
+ *        sink: function the trace is handed over to, in NVM_TRACE_BUFFER_SIZE
+ *              chunks at most (if NULL, the trace is written to stdout)
+ *        data: passed along to the sink
+ */
+void nvm_set_trace(nvm_t *virtual_machine, bool on, nvm_trace_sink sink, void *data);
+
+/*
+ * name:        nvm_flush_trace
+ * description: hands whatever is left in the trace buffer over to the sink
+ */
+void nvm_flush_trace(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_profiler_start
+ * description: starts sampling the VMs call stack <hz> times a second of the
+ *              CPU time (using SIGPROF, so only one VM can be profiled at
+ *              a time); samples gathered by previous runs are kept
+ *
+ * parameters:
+ *
+ *          hz: the sampling rate (if 0, NVM_PROFILER_DEFAULT_HZ)
+ *       flags: NVM_PROFILE_* flags
+ *
+ * return:       0 - the profiler is running
+ *              -1 - the timer couldn't be set up
+ *              -2 - another VM is being profiled
+ */
+int nvm_profiler_start(nvm_t *virtual_machine, unsigned hz, unsigned flags);
+
+/*
+ * name:        nvm_profiler_stop
+ * description: stops sampling, the samples are kept until `nvm_destroy`
+ */
+void nvm_profiler_stop(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_profiler_dump
+ * description: writes the sampled stacks to <out> in the folded format (one
+ *              `main;caller;callee <count>` line per distinct stack), ready to
+ *              be fed to flame graph tools
+ * return:      the total number of samples
+ */
+uint64_t nvm_profiler_dump(nvm_t *virtual_machine, FILE *out);
+
+/*
+ * name:        nvm_stats
+ * description: gives access to the per-opcode execution statistics gathered
+ *              so far
+ * return:      pointer to the statistics or NULL if NVM was built without
+ *              NVM_STATS
+ */
+const nvm_stats_t *nvm_stats(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_reset_stats
+ * description: zeroes the per-opcode execution statistics
+ */
+void nvm_reset_stats(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_gc
+ * description: collects the garbage right away
+ */
+void nvm_gc(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_gc_stats
+ * description: gives access to the garbage collectors statistics
+ */
+const nvm_gc_stats_t *nvm_gc_stats(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_print_stats
+ * description: prints the per-opcode execution statistics (counts, cycles and
+ *              the cycles histogram) of every opcode that was executed
+ */
+void nvm_print_stats(nvm_t *virtual_machine);
+
 #endif /* NVM_H */
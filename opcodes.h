@@ -42,7 +42,8 @@
 #define LOAD_NAME                           0x0A
 /* Duplicate the FOS */
 #define DUP                                 0x0B
-/* Indicates the beginning of a function body */
+/* Indicates the beginning of a function body (the name, like STORE has, and
+ * then the number of its arguments) */
 #define FN_START                            0x0C
 /* Indicates the end of a function body */
 #define FN_END                              0x0D
@@ -52,5 +53,63 @@
 #define ENTER_BLOCK                         0x0F
 /* Leaving a block */
 #define LEAVE_BLOCK                         0x10
+/* Push a 64-bit integer constant (the next eight bytes, little endian) */
+#define LOAD_CONST_LONG                     0x11
+/* Push a double constant (the next eight bytes, IEEE 754, little endian) */
+#define LOAD_CONST_DOUBLE                   0x12
+
+/*
+ * Quickened binary ops, specialized for both operands being of one type. The
+ * compiler never emits them: the VM rewrites the generic op into one of these
+ * the first time it runs it, and back once the operands' types change.
+ */
+#define BINARY_ADD_INT                      0x13
+#define BINARY_SUB_INT                      0x14
+#define BINARY_MUL_INT                      0x15
+#define BINARY_DIV_INT                      0x16
+#define BINARY_ADD_DOUBLE                   0x17
+#define BINARY_SUB_DOUBLE                   0x18
+#define BINARY_MUL_DOUBLE                   0x19
+#define BINARY_DIV_DOUBLE                   0x1A
+
+/* Push a string constant (the length in the next four bytes, little endian,
+ * and then the bytes) */
+#define LOAD_CONST_STRING                   0x1B
+/* Push the value of the variable in the given slot of the block the given
+ * number of blocks out from the innermost one (the next two bytes: the depth
+ * and the slot), as the compiler resolved it */
+#define LOAD_LOCAL                          0x1C
+/* Store the FOS in the given slot of the given block, the same way (and then
+ * the variables name, like STORE has, for the slot it defines) */
+#define STORE_LOCAL                         0x1D
+/* Call a function, as the last thing the calling function does (so the callee
+ * takes its frame over); the VM puts it in place of the CALLs it finds in the
+ * tail position */
+#define TAIL_CALL                           0x1E
+/* Return from the function, with the FOS as its result (which takes the place
+ * of the arguments and whatever else the function left on the stack) */
+#define RETURN                              0x1F
+/* Push the value of the functions argument (the next byte is which one, the
+ * first one pushed being 0) */
+#define LOAD_ARG                            0x20
+/* Store the FOS in the functions argument, the same way */
+#define STORE_ARG                           0x21
+/* Pop the FOS and hand it over to whoever resumed the coroutine, suspending
+ * it until it's resumed again (the main program yields to the host, see
+ * `nvm_resume`) */
+#define YIELD                               0x22
+/* Resume the coroutine of the function (the name, like CALL has), starting it
+ * if there's none, with its arguments taken off the stack; push what it
+ * yields, or what it leaves on its stack once it ends */
+#define RESUME                              0x23
+/* Send the FOS over the CHANNEL in the SOS (a copy of it, popping both); if
+ * the channel is full, the VM stops until there's room (see NVM_BLOCKED) */
+#define SEND                                0x24
+/* Take the next value off the CHANNEL in the FOS, in place of it; if there's
+ * none, the VM stops until there is */
+#define RECV                                0x25
+
+/* Number of opcodes above (one past the highest one) */
+#define OPCODES_COUNT                       0x26
 
 #endif /* OPCODES_H */
@@ -0,0 +1,339 @@
+/*
+ *
+ * profiler.c
+ *
+ * Created at:  10/18/2026 05:12:40 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * A sampling profiler for the NVM functions.
+ *
+ * SIGPROF fires at the given rate and only raises a flag, the interpreter then
+ * records the call stack before executing the next instruction. Equal stacks
+ * are counted together and dumped in the folded format that flame graph tools
+ * understand, one stack per line:
+ *
+ *   main;fib;fib 42
+ *
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "nvm.h"
+#include "profiler.h"
+
+/* Initial number of slots in the samples table (must be a power of two) */
+#define INITIAL_SAMPLES_SIZE 64
+
+volatile sig_atomic_t nvm_profiler_pending = 0;
+
+/* the timer is per process, so only one VM can be profiled at a time */
+static nvm_t *profiled = NULL;
+
+/*
+ * A stack that was sampled, and how many times.
+ */
+typedef struct {
+  /* the folded stack */
+  char *stack;
+  /* its hash */
+  uint32_t hash;
+  /* number of samples */
+  uint64_t count;
+} nvm_profiler_entry;
+
+struct _nvm_profiler {
+  /* NVM_PROFILE_* flags */
+  unsigned flags;
+  /* the hash table of sampled stacks */
+  nvm_profiler_entry *entries;
+  /* number of slots in the table */
+  size_t size;
+  /* number of slots in use */
+  size_t used;
+  /* total number of samples */
+  uint64_t samples;
+  /* where the stacks are folded into */
+  char *key;
+  /* size of the above */
+  size_t key_size;
+  /* what was there before we took over SIGPROF and the timer */
+  struct sigaction old_action;
+  struct itimerval old_timer;
+};
+
+/*
+ * name:        on_sigprof
+ * description: the SIGPROF handler, it just asks for a sample
+ */
+static void on_sigprof(int sig)
+{
+  (void)sig;
+  nvm_profiler_pending = 1;
+}
+
+/*
+ * name:        hash
+ * description: FNV-1a of the given string
+ */
+static uint32_t hash(const char *s)
+{
+  uint32_t h = 2166136261u;
+
+  for (; *s; s++){
+    h ^= (BYTE)*s;
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+/*
+ * name:        append
+ * description: appends the frame to the folded stack in the profilers key,
+ *              returns the new length of the key
+ */
+static size_t append(nvm_t *vm, size_t len, const char *name, int ip)
+{
+  /* {{{ append body */
+  nvm_profiler *prof = vm->profiler;
+  /* the separator, the name, the offset and the NUL */
+  size_t needed = len + strlen(name) + 16;
+
+  if (needed > prof->key_size){
+    size_t new_size = prof->key_size * 2 > needed ? prof->key_size * 2 : needed;
+    char *new_key = vm->mallocer(new_size);
+    if (!new_key){
+      fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", new_size, __LINE__ - 2);
+      exit(1);
+    }
+    memcpy(new_key, prof->key, len);
+    vm->freeer(prof->key);
+    prof->key = new_key;
+    prof->key_size = new_size;
+  }
+
+  if (prof->flags & NVM_PROFILE_IPS)
+    len += sprintf(prof->key + len, "%s%s+0x%04x", len ? ";" : "", name, ip);
+  else
+    len += sprintf(prof->key + len, "%s%s", len ? ";" : "", name);
+
+  return len;
+  /* }}} */
+}
+
+/*
+ * name:        grow
+ * description: doubles the size of the samples table
+ */
+static void grow(nvm_t *vm)
+{
+  /* {{{ grow body */
+  nvm_profiler *prof = vm->profiler;
+  size_t new_size = prof->size * 2;
+  nvm_profiler_entry *new_entries = vm->mallocer(new_size * sizeof(nvm_profiler_entry));
+
+  if (!new_entries){
+    fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", new_size * sizeof(nvm_profiler_entry), __LINE__ - 2);
+    exit(1);
+  }
+
+  memset(new_entries, 0, new_size * sizeof(nvm_profiler_entry));
+
+  for (size_t i = 0; i < prof->size; i++){
+    if (!prof->entries[i].stack)
+      continue;
+    size_t slot = prof->entries[i].hash & (new_size - 1);
+    while (new_entries[slot].stack)
+      slot = (slot + 1) & (new_size - 1);
+    new_entries[slot] = prof->entries[i];
+  }
+
+  vm->freeer(prof->entries);
+  prof->entries = new_entries;
+  prof->size = new_size;
+  /* }}} */
+}
+
+void nvm_profiler_sample(nvm_t *vm)
+{
+  /* {{{ nvm_profiler_sample body */
+  nvm_profiler *prof = vm->profiler;
+  size_t len = 0;
+  const char *name = "main";
+
+  nvm_profiler_pending = 0;
+
+  if (!prof || !vm->profiling)
+    return;
+
+  /* fold the stack, starting with the outermost call; every frame is
+   * where its caller is at */
+  for (nvm_call_frame *p = vm->call_stack->tail; p != NULL; p = p->next){
+    len = append(vm, len, name, p->ip);
+    name = p->fn_name;
+  }
+  len = append(vm, len, name, vm->ip);
+
+  /* count it in */
+  uint32_t h = hash(prof->key);
+  size_t slot = h & (prof->size - 1);
+
+  while (prof->entries[slot].stack){
+    if (prof->entries[slot].hash == h && !strcmp(prof->entries[slot].stack, prof->key))
+      break;
+    slot = (slot + 1) & (prof->size - 1);
+  }
+
+  if (!prof->entries[slot].stack){
+    char *stack = vm->mallocer(len + 1);
+    if (!stack){
+      fprintf(stderr, "nvm: error: failed to allocate %lu bytes at line %d\n", len + 1, __LINE__ - 2);
+      exit(1);
+    }
+    memcpy(stack, prof->key, len + 1);
+    prof->entries[slot].stack = stack;
+    prof->entries[slot].hash = h;
+    prof->entries[slot].count = 0;
+    prof->used++;
+  }
+
+  prof->entries[slot].count++;
+  prof->samples++;
+
+  /* keep the table at most 3/4 full */
+  if (prof->used * 4 >= prof->size * 3)
+    grow(vm);
+  /* }}} */
+}
+
+int nvm_profiler_start(nvm_t *vm, unsigned hz, unsigned flags)
+{
+  /* {{{ nvm_profiler_start body */
+  nvm_profiler *prof = vm->profiler;
+
+  if (profiled && profiled != vm)
+    return -2;
+
+  if (vm->profiling)
+    return 0;
+
+  if (!hz)
+    hz = NVM_PROFILER_DEFAULT_HZ;
+
+  /* set up the samples table the first time */
+  if (!prof){
+    prof = vm->mallocer(sizeof(nvm_profiler));
+    if (!prof)
+      return -1;
+    prof->size     = INITIAL_SAMPLES_SIZE;
+    prof->used     = 0;
+    prof->samples  = 0;
+    prof->key_size = 256;
+    prof->key      = vm->mallocer(prof->key_size);
+    prof->entries  = vm->mallocer(prof->size * sizeof(nvm_profiler_entry));
+    if (!prof->key || !prof->entries){
+      if (prof->key)
+        vm->freeer(prof->key);
+      if (prof->entries)
+        vm->freeer(prof->entries);
+      vm->freeer(prof);
+      return -1;
+    }
+    memset(prof->entries, 0, prof->size * sizeof(nvm_profiler_entry));
+    vm->profiler = prof;
+  }
+
+  prof->flags = flags;
+
+  /* take over SIGPROF */
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_sigprof;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &prof->old_action))
+    return -1;
+
+  /* and arm the timer */
+  struct itimerval timer;
+  timer.it_interval.tv_sec  = 0;
+  timer.it_interval.tv_usec = hz > 1000000 ? 1 : 1000000 / hz;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, &prof->old_timer)){
+    sigaction(SIGPROF, &prof->old_action, NULL);
+    return -1;
+  }
+
+  nvm_profiler_pending = 0;
+  profiled = vm;
+  vm->profiling = true;
+
+  return 0;
+  /* }}} */
+}
+
+void nvm_profiler_stop(nvm_t *vm)
+{
+  /* {{{ nvm_profiler_stop body */
+  if (!vm->profiling)
+    return;
+
+  setitimer(ITIMER_PROF, &vm->profiler->old_timer, NULL);
+  sigaction(SIGPROF, &vm->profiler->old_action, NULL);
+
+  nvm_profiler_pending = 0;
+  profiled = NULL;
+  vm->profiling = false;
+  /* }}} */
+}
+
+uint64_t nvm_profiler_dump(nvm_t *vm, FILE *out)
+{
+  /* {{{ nvm_profiler_dump body */
+  nvm_profiler *prof = vm->profiler;
+
+  if (!prof)
+    return 0;
+
+  for (size_t i = 0; i < prof->size; i++){
+    if (prof->entries[i].stack)
+      fprintf(out, "%s %llu\n", prof->entries[i].stack, (unsigned long long)prof->entries[i].count);
+  }
+
+  return prof->samples;
+  /* }}} */
+}
+
+void nvm_profiler_free(nvm_t *vm)
+{
+  /* {{{ nvm_profiler_free body */
+  nvm_profiler *prof = vm->profiler;
+
+  if (!prof)
+    return;
+
+  nvm_profiler_stop(vm);
+
+  for (size_t i = 0; i < prof->size; i++){
+    if (prof->entries[i].stack)
+      vm->freeer(prof->entries[i].stack);
+  }
+
+  vm->freeer(prof->entries);
+  vm->freeer(prof->key);
+  vm->freeer(prof);
+  vm->profiler = NULL;
+  /* }}} */
+}
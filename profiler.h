@@ -0,0 +1,41 @@
+/*
+ *
+ * profiler.h
+ *
+ * Created at:  10/18/2026 05:12:40 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The bits of the sampling profiler the interpreter loop needs to know about.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <signal.h>
+
+#include "nvm.h"
+
+/*
+ * Set by the timer whenever it's time to take another sample.
+ */
+extern volatile sig_atomic_t nvm_profiler_pending;
+
+/*
+ * name:        nvm_profiler_sample
+ * description: records the VMs current call stack and clears the pending flag
+ */
+void nvm_profiler_sample(nvm_t *virtual_machine);
+
+/*
+ * name:        nvm_profiler_free
+ * description: stops the profiler (if it's running) and frees the samples
+ */
+void nvm_profiler_free(nvm_t *virtual_machine);
+
+#endif /* PROFILER_H */
@@ -0,0 +1,788 @@
+/*
+ *
+ * regress.c
+ *
+ * Created at:  10/18/2026 07:21:37 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * Differential regression harness for NVM.
+ *
+ * Generates random (but well-formed) programs, compiles them with the grammar
+ * and runs every one of them through every engine: each of the given builds
+ * (different optimization levels, NVM_STATS, ...) runs them with each of its
+ * interpreter loops (plain, traced, profiled). The final stack and variables
+ * of every engine have to be the same as the ones the generator computed (in
+ * 128 bits, so the INTEGERs overflowing into LONGs and BIGINTs are checked
+ * too), and, when given a baseline of timings recorded earlier, no engine may be
+ * slower than the threshold allows.
+ *
+ * Every engine also runs a program with an unknown opcode in it (which can't
+ * be validated, so it's run without), and it has to fail with NVM_ERROR,
+ * instead of going on or going down.
+ *
+ * Usage: nvm_regress [-n programs] [-l statements] [-s seed] [-r repetitions]
+ *                    [-t threshold] [-b baseline] [-o record] build...
+ *        nvm_regress --run file.nc repetitions
+ *        nvm_regress --fail file.nc
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nvm.h"
+#include "grammar.h"
+
+/* Default number of programs */
+#define DEFAULT_PROGRAMS 50
+/* Default number of statements in a program */
+#define DEFAULT_STATEMENTS 200
+/* Default number of times each engine runs each program */
+#define DEFAULT_REPETITIONS 5
+/* Default allowed slowdown against the baseline (0.20 is 20%) */
+#define DEFAULT_THRESHOLD 0.20
+/* Maximum number of engines */
+#define MAX_ENGINES 64
+/* Number of variables names the programs can use */
+#define NAMES_COUNT 12
+/* Maximum depth of the generated expressions */
+#define MAX_DEPTH 4
+/* Maximum depth of the generated blocks */
+#define MAX_BLOCKS 3
+/* One in how many results that don't fit in an INTEGER is kept */
+#define OVERFLOW_ODDS 4
+
+/* the grammar writes the bytecode here */
+FILE *fp;
+
+typedef union {
+  int i;
+  char *s;
+} TokenType;
+
+/* Lemon stuff */
+void *ParseAlloc(void *(*)(size_t));
+void  Parse(void *, int, TokenType);
+void  ParseFree(void *, void (*)(void*));
+
+/*
+ * The values the generator computes, wide enough for what the programs
+ * overflow into.
+ */
+typedef __int128 wide_t;
+
+/*
+ * A token for the grammar.
+ */
+typedef struct {
+  int type;
+  TokenType value;
+} token_t;
+
+/*
+ * A generated program: its tokens and the state it should end up in.
+ */
+typedef struct {
+  token_t *tokens;
+  size_t count;
+  size_t size;
+  /* the values left on the stack */
+  wide_t *stack;
+  size_t stack_count;
+  size_t stack_size;
+  /* values of the variables, and when they were defined (0 if they're not) */
+  wide_t values[NAMES_COUNT];
+  unsigned long stored[NAMES_COUNT];
+} program_t;
+
+/*
+ * An engine: a build and the loop it runs the programs with.
+ */
+typedef struct {
+  char *name;
+  /* total of the best times of every program */
+  double ns;
+  /* the baseline's total (negative if there's none) */
+  double baseline_ns;
+} engine_t;
+
+/* the interpreter loops every build runs the programs with */
+static const char *loops[] = { "plain", "traced", "profiled" };
+
+#define LOOPS_COUNT (sizeof(loops) / sizeof(loops[0]))
+
+static char *names[NAMES_COUNT] = {
+  "a", "b", "c", "d", "x", "y", "z", "n", "acc", "tmp", "sum", "i"
+};
+
+/*
+ * name:        now
+ * description: returns the monotonic time in nanoseconds
+ */
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* {{{ the runner side */
+/*
+ * name:        discard
+ * description: a trace sink that drops everything
+ */
+static void discard(void *data, const char *buf, size_t len)
+{
+  (void)buf;
+  *(size_t *)data += len;
+}
+
+/*
+ * name:        use_loop
+ * description: makes the <vm> run with the interpreter loop of the <engine>
+ */
+static void use_loop(nvm_t *vm, const char *engine, size_t *traced)
+{
+  if (!strcmp(engine, "traced"))
+    nvm_set_trace(vm, true, discard, traced);
+  else if (!strcmp(engine, "profiled"))
+    nvm_profiler_start(vm, NVM_PROFILER_DEFAULT_HZ, 0);
+}
+
+/*
+ * name:        run_engine
+ * description: runs the program <repetitions> times with the given loop, then
+ *              prints the best time and the state the program ended up in
+ */
+static void run_engine(const char *file, const char *engine, unsigned repetitions)
+{
+  /* {{{ run_engine body */
+  double best = -1;
+  size_t traced = 0;
+
+  for (unsigned r = 0; r < repetitions; r++){
+    nvm_t *vm = nvm_init(file, NULL, NULL);
+
+    if (!vm || nvm_validate(vm) != 0){
+      fprintf(stderr, "nvm_regress: couldn't load %s\n", file);
+      exit(1);
+    }
+
+    use_loop(vm, engine, &traced);
+
+    double start = now();
+    nvm_blastoff(vm);
+    double elapsed = now() - start;
+
+    if (best < 0 || elapsed < best)
+      best = elapsed;
+
+    /* the state is the same every time, print it once */
+    if (r == repetitions - 1){
+      printf("engine %s %.0f\n", engine, best);
+      nvm_print_stack(vm);
+      nvm_print_vars(vm);
+      printf("end\n");
+    }
+
+    nvm_destroy(vm);
+  }
+  /* }}} */
+}
+
+/*
+ * name:        run
+ * description: the runner: runs the program with every loop this build has
+ */
+static int run(const char *file, unsigned repetitions)
+{
+  for (unsigned i = 0; i < LOOPS_COUNT; i++)
+    run_engine(file, loops[i], repetitions);
+
+  return 0;
+}
+
+/*
+ * name:        run_failing
+ * description: the runner: runs the program that has to fail (unvalidated)
+ *              with every loop this build has, and prints what each of them
+ *              ended with
+ */
+static int run_failing(const char *file)
+{
+  /* {{{ run_failing body */
+  size_t traced = 0;
+
+  for (unsigned i = 0; i < LOOPS_COUNT; i++){
+    nvm_t *vm = nvm_init(file, NULL, NULL);
+
+    if (!vm){
+      fprintf(stderr, "nvm_regress: couldn't load %s\n", file);
+      exit(1);
+    }
+
+    use_loop(vm, loops[i], &traced);
+    printf("engine %s status %d\n", loops[i], nvm_blastoff(vm));
+    nvm_destroy(vm);
+  }
+
+  return 0;
+  /* }}} */
+}
+/* }}} */
+
+/* {{{ generating */
+static void push_token(program_t *prog, int type, int i, char *s)
+{
+  if (prog->count == prog->size){
+    prog->size = prog->size ? prog->size * 2 : 256;
+    prog->tokens = realloc(prog->tokens, prog->size * sizeof(token_t));
+    if (!prog->tokens){
+      fprintf(stderr, "nvm_regress: failed to allocate %lu bytes\n", prog->size * sizeof(token_t));
+      exit(1);
+    }
+  }
+  prog->tokens[prog->count].type = type;
+  if (s)
+    prog->tokens[prog->count].value.s = s;
+  else
+    prog->tokens[prog->count].value.i = i;
+  prog->count++;
+}
+
+static void push_value(program_t *prog, wide_t value)
+{
+  if (prog->stack_count == prog->stack_size){
+    prog->stack_size = prog->stack_size ? prog->stack_size * 2 : 64;
+    prog->stack = realloc(prog->stack, prog->stack_size * sizeof(wide_t));
+    if (!prog->stack){
+      fprintf(stderr, "nvm_regress: failed to allocate %lu bytes\n", prog->stack_size * sizeof(wide_t));
+      exit(1);
+    }
+  }
+  prog->stack[prog->stack_count++] = value;
+}
+
+/*
+ * name:        gen_expr
+ * description: generates an expression, and computes its value; the
+ *              expressions never divide by zero, and once in a while they
+ *              overflow an INTEGER (but never 128 bits)
+ */
+static wide_t gen_expr(program_t *prog, unsigned depth)
+{
+  /* {{{ gen_expr body */
+  unsigned defined[NAMES_COUNT], defined_count = 0;
+
+  for (unsigned i = 0; i < NAMES_COUNT; i++)
+    if (prog->stored[i])
+      defined[defined_count++] = i;
+
+  /* a leaf */
+  if (depth >= MAX_DEPTH || rand() % 3 == 0){
+    if (defined_count && rand() % 2){
+      unsigned var = defined[rand() % defined_count];
+      push_token(prog, NAME, 0, names[var]);
+      return prog->values[var];
+    }
+    INT number = rand() % 1000;
+    push_token(prog, NUMBER, number, NULL);
+    return number;
+  }
+
+  /* an operation, tried until it fits (in an INTEGER, but for the ones that
+   * are let overflow) */
+  for (;;){
+    static const int ops[] = { PLUS, MINUS, TIMES, DIVIDE };
+    size_t mark = prog->count;
+    int op = ops[rand() % 4];
+    wide_t left, right, result;
+    bool overflow = false;
+
+    push_token(prog, LPAREN, 0, NULL);
+    left = gen_expr(prog, depth + 1);
+    push_token(prog, op, 0, NULL);
+    /* divide only by small positive constants, so there's neither division
+     * by zero nor INT_MIN / -1 */
+    if (op == DIVIDE){
+      right = 1 + rand() % 9;
+      push_token(prog, NUMBER, right, NULL);
+    } else {
+      right = gen_expr(prog, depth + 1);
+    }
+    push_token(prog, RPAREN, 0, NULL);
+
+    switch (op){
+      case PLUS:   overflow = __builtin_add_overflow(left, right, &result); break;
+      case MINUS:  overflow = __builtin_sub_overflow(left, right, &result); break;
+      case TIMES:  overflow = __builtin_mul_overflow(left, right, &result); break;
+      default:     result = left / right; break;
+    }
+
+    if (!overflow && ((result >= INT32_MIN && result <= INT32_MAX) || rand() % OVERFLOW_ODDS == 0))
+      return result;
+
+    /* try again */
+    prog->count = mark;
+  }
+  /* }}} */
+}
+
+/*
+ * name:        gen_stmt
+ * description: generates the <s>th statement, <blocks> blocks deep
+ */
+static void gen_stmt(program_t *prog, unsigned long s, unsigned blocks)
+{
+  /* {{{ gen_stmt body */
+  /* once in a while, a block: it sees the variables around it and the stack,
+   * and its own variables are gone after it */
+  if (blocks < MAX_BLOCKS && rand() % 16 == 0){
+    unsigned long outer[NAMES_COUNT];
+    unsigned statements = 1 + rand() % 4;
+
+    memcpy(outer, prog->stored, sizeof(outer));
+    push_token(prog, LBRACE, 0, NULL);
+    for (unsigned i = 0; i < statements; i++){
+      if (i)
+        push_token(prog, SEMICOLON, 0, NULL);
+      gen_stmt(prog, s, blocks + 1);
+    }
+    push_token(prog, RBRACE, 0, NULL);
+
+    for (unsigned i = 0; i < NAMES_COUNT; i++)
+      if (!outer[i])
+        prog->stored[i] = 0;
+    return;
+  }
+
+  /* mostly assignments, the rest stays on the stack */
+  if (rand() % 4){
+    unsigned var = rand() % NAMES_COUNT;
+    push_token(prog, NAME, 0, names[var]);
+    push_token(prog, EQ, 0, NULL);
+    prog->values[var] = gen_expr(prog, 0);
+    if (!prog->stored[var])
+      prog->stored[var] = s;
+  } else {
+    push_value(prog, gen_expr(prog, 0));
+  }
+  /* }}} */
+}
+
+/*
+ * name:        generate
+ * description: generates a program of <statements> statements
+ */
+static void generate(program_t *prog, unsigned statements)
+{
+  /* {{{ generate body */
+  prog->count = 0;
+  prog->stack_count = 0;
+  memset(prog->stored, 0, sizeof(prog->stored));
+
+  for (unsigned long s = 1; s <= statements; s++){
+    if (s > 1)
+      push_token(prog, SEMICOLON, 0, NULL);
+    gen_stmt(prog, s, 0);
+  }
+  /* }}} */
+}
+
+/*
+ * name:        compile
+ * description: feeds the programs tokens to the grammar, which writes the
+ *              bytecode to the <file>
+ */
+static void compile(const program_t *prog, const char *file)
+{
+  /* {{{ compile body */
+  BYTE version[3] = { NVM_VERSION_MAJOR, NVM_VERSION_MINOR, NVM_VERSION_PATCH };
+  TokenType token;
+
+  fp = fopen(file, "wb");
+  if (!fp){
+    fprintf(stderr, "nvm_regress: couldn't write %s\n", file);
+    exit(1);
+  }
+  fwrite(version, sizeof(version), 1, fp);
+
+  void *parser = ParseAlloc(malloc);
+  for (size_t i = 0; i < prog->count; i++)
+    Parse(parser, prog->tokens[i].type, prog->tokens[i].value);
+  token.i = 0;
+  Parse(parser, 0, token);
+  ParseFree(parser, free);
+
+  fclose(fp);
+  /* }}} */
+}
+
+/*
+ * name:        format
+ * description: prints the <value> in decimal to <buf> (of at least 41 bytes)
+ * return:      the <buf>
+ */
+static char *format(char *buf, wide_t value)
+{
+  /* {{{ format body */
+  char digits[40], *p = buf;
+  unsigned count = 0;
+  /* (the magnitude of the most negative one fits too) */
+  unsigned __int128 magnitude = value < 0 ? -(unsigned __int128)value : (unsigned __int128)value;
+
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+
+  if (value < 0)
+    *p++ = '-';
+  while (count)
+    *p++ = digits[--count];
+  *p = '\0';
+
+  return buf;
+  /* }}} */
+}
+
+/*
+ * name:        expected
+ * description: prints the state the program should end up in, the way
+ *              `nvm_print_stack` and `nvm_print_vars` do
+ */
+static void expected(const program_t *prog, char *buf, size_t size)
+{
+  /* {{{ expected body */
+  size_t len = 0;
+  unsigned order[NAMES_COUNT], count = 0;
+  char value[41];
+
+  if (!prog->stack_count)
+    len += snprintf(buf + len, size - len, "the stack is empty\n");
+  for (size_t i = 0; i < prog->stack_count && len < size; i++)
+    len += snprintf(buf + len, size - len, "item on stack: %s\n", format(value, prog->stack[i]));
+
+  /* the most recently defined ones first */
+  for (unsigned i = 0; i < NAMES_COUNT; i++){
+    if (!prog->stored[i])
+      continue;
+    unsigned j = count++;
+    while (j > 0 && prog->stored[order[j - 1]] < prog->stored[i]){
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  if (!count && len < size)
+    len += snprintf(buf + len, size - len, "there are no variables\n");
+  for (unsigned i = 0; i < count && len < size; i++)
+    len += snprintf(buf + len, size - len, "variable %s: %s\n", names[order[i]], format(value, prog->values[order[i]]));
+  /* }}} */
+}
+/* }}} */
+
+/* {{{ the driver side */
+static engine_t engines[MAX_ENGINES];
+static unsigned engines_count = 0;
+
+static engine_t *find_engine(const char *name, bool add)
+{
+  for (unsigned i = 0; i < engines_count; i++)
+    if (!strcmp(engines[i].name, name))
+      return &engines[i];
+
+  if (!add || engines_count == MAX_ENGINES)
+    return NULL;
+
+  engines[engines_count].name = strdup(name);
+  engines[engines_count].ns = 0;
+  engines[engines_count].baseline_ns = -1;
+
+  return &engines[engines_count++];
+}
+
+/*
+ * name:        check
+ * description: runs the program with every loop of the <build>, returns the
+ *              number of engines that ended up in a different state
+ */
+static unsigned check(const char *build, const char *file, unsigned repetitions,
+    const char *want, unsigned program)
+{
+  /* {{{ check body */
+  char command[4096], line[256], name[512], *got;
+  size_t got_size = strlen(want) + 4096, got_len = 0;
+  unsigned failures = 0;
+  engine_t *engine = NULL;
+  double ns;
+  FILE *pipe;
+
+  snprintf(command, sizeof(command), "%s --run %s %u", build, file, repetitions);
+  if (!(pipe = popen(command, "r"))){
+    fprintf(stderr, "nvm_regress: couldn't run %s\n", build);
+    exit(1);
+  }
+
+  got = malloc(got_size);
+  if (!got){
+    fprintf(stderr, "nvm_regress: failed to allocate %lu bytes\n", got_size);
+    exit(1);
+  }
+
+  while (fgets(line, sizeof(line), pipe)){
+    char loop[64];
+
+    if (sscanf(line, "engine %63s %lf", loop, &ns) == 2){
+      snprintf(name, sizeof(name), "%s:%s", build, loop);
+      engine = find_engine(name, true);
+      if (engine)
+        engine->ns += ns;
+      got_len = 0;
+      got[0] = '\0';
+    } else if (!strcmp(line, "end\n")){
+      if (strcmp(got, want)){
+        printf("FAIL: program %u: %s ended up in a different state\n"
+            "--- expected\n%s--- got\n%s", program, name, want, got);
+        failures++;
+      }
+      engine = NULL;
+    } else if (got_len + strlen(line) < got_size){
+      strcpy(got + got_len, line);
+      got_len += strlen(line);
+    }
+  }
+
+  if (pclose(pipe) != 0){
+    printf("FAIL: program %u: %s didn't finish cleanly\n", program, build);
+    failures++;
+  }
+
+  free(got);
+
+  return failures;
+  /* }}} */
+}
+
+/*
+ * name:        check_failing
+ * description: runs the program with an unknown opcode in it with every loop
+ *              of the <build>, returns the number of engines that didn't fail
+ *              it cleanly
+ */
+static unsigned check_failing(const char *build, const char *file)
+{
+  /* {{{ check_failing body */
+  /* a LOAD_CONST, and an op there's no such thing as */
+  BYTE code[] = { NVM_VERSION_MAJOR, NVM_VERSION_MINOR, NVM_VERSION_PATCH,
+                  LOAD_CONST, 7, 0, 0, 0, 0xFF };
+  char command[4096], line[256], loop[64];
+  unsigned failures = 0, ran = 0;
+  int status;
+  FILE *f = fopen(file, "wb"), *pipe;
+
+  if (!f){
+    fprintf(stderr, "nvm_regress: couldn't write %s\n", file);
+    exit(1);
+  }
+  fwrite(code, sizeof(code), 1, f);
+  fclose(f);
+
+  /* (what the VMs report about the op is expected, so it's dropped) */
+  snprintf(command, sizeof(command), "%s --fail %s 2>/dev/null", build, file);
+  if (!(pipe = popen(command, "r"))){
+    fprintf(stderr, "nvm_regress: couldn't run %s\n", build);
+    exit(1);
+  }
+
+  while (fgets(line, sizeof(line), pipe)){
+    if (sscanf(line, "engine %63s status %d", loop, &status) != 2)
+      continue;
+    ran++;
+    if (status != NVM_ERROR){
+      printf("FAIL: the unknown op: %s:%s ended with %d instead of failing\n", build, loop, status);
+      failures++;
+    }
+  }
+
+  if (pclose(pipe) != 0 || ran != LOOPS_COUNT){
+    printf("FAIL: the unknown op: %s didn't finish cleanly\n", build);
+    failures++;
+  }
+
+  return failures;
+  /* }}} */
+}
+
+/*
+ * name:        load_baseline
+ * description: reads the `engine ns` lines recorded by an earlier run
+ */
+static void load_baseline(const char *file)
+{
+  /* {{{ load_baseline body */
+  char name[512];
+  double ns;
+  FILE *f = fopen(file, "r");
+
+  if (!f){
+    fprintf(stderr, "nvm_regress: couldn't read %s\n", file);
+    exit(1);
+  }
+
+  while (fscanf(f, "%511s %lf", name, &ns) == 2){
+    engine_t *engine = find_engine(name, true);
+    if (engine)
+      engine->baseline_ns = ns;
+  }
+
+  fclose(f);
+  /* }}} */
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: nvm_regress [-n programs] [-l statements] [-s seed] [-r repetitions]\n"
+                  "                   [-t threshold] [-b baseline] [-o record] build...\n"
+                  "       nvm_regress --run file.nc repetitions\n"
+                  "       nvm_regress --fail file.nc\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned programs = DEFAULT_PROGRAMS, statements = DEFAULT_STATEMENTS;
+  unsigned repetitions = DEFAULT_REPETITIONS, seed = 1, failures = 0, slower = 0;
+  double threshold = DEFAULT_THRESHOLD;
+  const char *baseline = NULL, *record = NULL;
+  char **builds = NULL;
+  int builds_count = 0;
+  char file[] = "/tmp/nvm-regress-XXXXXX";
+  program_t prog;
+  int fd;
+
+  if (argc == 4 && !strcmp(argv[1], "--run"))
+    return run(argv[2], strtoul(argv[3], NULL, 10));
+  if (argc == 3 && !strcmp(argv[1], "--fail"))
+    return run_failing(argv[2]);
+
+  for (int i = 1; i < argc; i++){
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      programs = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+      statements = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      seed = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      repetitions = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      threshold = strtod(argv[++i], NULL);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      baseline = argv[++i];
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      record = argv[++i];
+    else if (argv[i][0] == '-')
+      usage();
+    else {
+      builds = &argv[i];
+      builds_count = argc - i;
+      break;
+    }
+  }
+
+  if (!builds_count || !statements || !repetitions)
+    usage();
+
+  if (baseline)
+    load_baseline(baseline);
+
+  if ((fd = mkstemp(file)) < 0){
+    fprintf(stderr, "nvm_regress: couldn't create a scratch file\n");
+    return 1;
+  }
+  close(fd);
+
+  memset(&prog, 0, sizeof(prog));
+  srand(seed);
+
+  for (unsigned p = 0; p < programs; p++){
+    size_t want_size = 64 * (statements + NAMES_COUNT + 2);
+    char *want = malloc(want_size);
+
+    if (!want){
+      fprintf(stderr, "nvm_regress: failed to allocate %lu bytes\n", want_size);
+      return 1;
+    }
+
+    generate(&prog, statements);
+    compile(&prog, file);
+    expected(&prog, want, want_size);
+
+    for (int b = 0; b < builds_count; b++)
+      failures += check(builds[b], file, repetitions, want, p);
+
+    free(want);
+  }
+
+  for (int b = 0; b < builds_count; b++)
+    failures += check_failing(builds[b], file);
+
+  unlink(file);
+
+  printf("## %u programs of %u statements, seed %u ##\n\n", programs, statements, seed);
+
+  for (unsigned i = 0; i < engines_count; i++){
+    engine_t *engine = &engines[i];
+
+    /* an engine that's only in the baseline */
+    if (!engine->ns)
+      continue;
+
+    printf("%-40s %14.0f ns", engine->name, engine->ns);
+    if (engine->baseline_ns > 0){
+      double ratio = engine->ns / engine->baseline_ns;
+      printf("  (%+.1f%% against the baseline)", (ratio - 1) * 100);
+      if (ratio > 1 + threshold){
+        printf("  SLOWER");
+        slower++;
+      }
+    }
+    printf("\n");
+  }
+
+  if (record){
+    FILE *f = fopen(record, "w");
+    if (!f){
+      fprintf(stderr, "nvm_regress: couldn't write %s\n", record);
+      return 1;
+    }
+    for (unsigned i = 0; i < engines_count; i++)
+      if (engines[i].ns)
+        fprintf(f, "%s %.0f\n", engines[i].name, engines[i].ns);
+    fclose(f);
+  }
+
+  if (failures)
+    printf("\n%u engine runs ended up in a different state\n", failures);
+  if (slower)
+    printf("\n%u engines got slower by more than %.0f%%\n", slower, threshold * 100);
+
+  free(prog.tokens);
+  free(prog.stack);
+
+  return failures || slower ? 1 : 0;
+}
+/* }}} */
@@ -0,0 +1,498 @@
+/*
+ *
+ * sched.c
+ *
+ * Created at:  10/19/2026 05:12:48 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The M:N scheduler.
+ *
+ * Every VM is a green thread: it runs on one of the few OS threads (the
+ * workers) until it runs out of the slice of fuel it was given, and then it's
+ * the next ones turn. Running out of fuel leaves the whole VM where it was, so
+ * it goes on later on whichever worker gets to it, and none of them can keep
+ * a worker to itself (see `nvm_set_fuel`).
+ *
+ * Each worker has its own run queue, so they don't fight over one: it takes
+ * the VMs off the front of it and puts the ones that are out of fuel back at
+ * the end. The one that runs out of them steals half of the queue of another
+ * one (the oldest half, which has waited the longest), and only when there's
+ * nothing to steal anywhere it goes to sleep, till something is spawned.
+ *
+ * The VM that's blocked on a channel is in no queue at all: it's parked on
+ * the channel, and the VM that SENDs or RECVs on the other side puts it back
+ * in the queue of the worker it ran on.
+ *
+ * The VMs share nothing, so they need no locks to run side by side (but the
+ * profiler, which can only profile one VM at a time).
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "nvm.h"
+#include "sched.h"
+#include "channel.h"
+
+/*
+ * A run queue (the tasks are linked through their `next`).
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  nvm_task *head;
+  nvm_task *tail;
+  size_t count;
+} queue_t;
+
+/*
+ * An OS thread running the tasks.
+ */
+typedef struct {
+  nvm_sched *sched;
+  pthread_t thread;
+  queue_t queue;
+  /* for picking the ones to steal from */
+  uint32_t seed;
+} worker_t;
+
+struct _nvm_task {
+  /* it's parked with it (and it's the first thing in the task, so the task
+   * is where the waiter is) */
+  nvm_waiter waiter;
+  nvm_t *vm;
+  /* the worker it ran on the last */
+  worker_t *worker;
+  /* whether it was blasted off already */
+  bool started;
+  /* whether it's done, and what it ended with */
+  bool done;
+  int status;
+  /* when it was put in the queue it's in */
+  uint64_t queued_at;
+  nvm_task_stats stats;
+  /* the next one in its queue */
+  nvm_task *next;
+  /* all the tasks that weren't joined yet */
+  nvm_task *prev_spawned;
+  nvm_task *next_spawned;
+};
+
+struct _nvm_sched {
+  worker_t *workers;
+  unsigned workers_count;
+  /* number of their threads that were started */
+  unsigned started;
+  /* fuel of every slice */
+  uint64_t slice;
+  /* guards the things below, but the counters (they're atomic) */
+  pthread_mutex_t lock;
+  /* the sleeping workers wait for something to run, and the joiners for the
+   * tasks to be done */
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  /* the tasks that weren't joined yet */
+  nvm_task *spawned;
+  /* the worker the next one goes to */
+  unsigned next_worker;
+  /* number of the tasks in the queues, and of the sleeping workers */
+  size_t queued;
+  unsigned sleeping;
+  /* whether the workers have to stop */
+  bool stopping;
+};
+
+/*
+ * name:        now
+ * description: returns the monotonic time in nanoseconds
+ */
+static uint64_t now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* {{{ queues */
+/*
+ * name:        append
+ * description: puts the <count> tasks from <first> to <last> at the end of the
+ *              <queue> (it has to be locked)
+ */
+static void append(queue_t *queue, nvm_task *first, nvm_task *last, size_t count)
+{
+  last->next = NULL;
+  if (queue->tail)
+    queue->tail->next = first;
+  else
+    queue->head = first;
+  queue->tail = last;
+  queue->count += count;
+}
+
+/*
+ * name:        take
+ * description: takes the first <count> tasks off the <queue> (it has to be
+ *              locked, and have them)
+ * return:      the first of them (they're linked, the last one to NULL)
+ */
+static nvm_task *take(queue_t *queue, size_t count)
+{
+  nvm_task *first = queue->head, *last = first;
+
+  for (size_t i = 1; i < count; i++)
+    last = last->next;
+
+  queue->head = last->next;
+  if (!queue->head)
+    queue->tail = NULL;
+  queue->count -= count;
+  last->next = NULL;
+
+  return first;
+}
+
+/*
+ * name:        enqueue
+ * description: puts the <task> at the end of the queue of the <worker>, and
+ *              wakes up a sleeping one (if there is any) to steal it
+ */
+static void enqueue(worker_t *worker, nvm_task *task)
+{
+  /* {{{ enqueue body */
+  nvm_sched *sched = worker->sched;
+
+  task->queued_at = now();
+
+  pthread_mutex_lock(&worker->queue.lock);
+  append(&worker->queue, task, task, 1);
+  pthread_mutex_unlock(&worker->queue.lock);
+
+  __atomic_add_fetch(&sched->queued, 1, __ATOMIC_SEQ_CST);
+
+  /* (they check `queued` with the lock held, so they can't miss it) */
+  if (__atomic_load_n(&sched->sleeping, __ATOMIC_SEQ_CST)){
+    pthread_mutex_lock(&sched->lock);
+    pthread_cond_signal(&sched->wake);
+    pthread_mutex_unlock(&sched->lock);
+  }
+  /* }}} */
+}
+
+/*
+ * name:        dequeue
+ * description: takes the first task off the queue of the <worker>
+ * return:      the task, or NULL if there's none
+ */
+static nvm_task *dequeue(worker_t *worker)
+{
+  /* {{{ dequeue body */
+  nvm_task *task = NULL;
+
+  pthread_mutex_lock(&worker->queue.lock);
+  if (worker->queue.count)
+    task = take(&worker->queue, 1);
+  pthread_mutex_unlock(&worker->queue.lock);
+
+  return task;
+  /* }}} */
+}
+
+/*
+ * name:        steal
+ * description: takes half the tasks (but at least one) off the queue of
+ *              another worker, the first one of them to run, and the rest to
+ *              the <worker>s own queue
+ * return:      the task to run, or NULL if there was nothing to steal
+ */
+static nvm_task *steal(worker_t *worker)
+{
+  /* {{{ steal body */
+  nvm_sched *sched = worker->sched;
+  unsigned count = sched->workers_count;
+
+  /* the victims are tried in turn, starting from a random one (so the
+   * thieves don't all go for the same) */
+  worker->seed ^= worker->seed << 13;
+  worker->seed ^= worker->seed >> 17;
+  worker->seed ^= worker->seed << 5;
+
+  for (unsigned i = 0; i < count; i++){
+    worker_t *victim = &sched->workers[(worker->seed + i) % count];
+    nvm_task *first, *last;
+    size_t stolen;
+
+    if (victim == worker)
+      continue;
+
+    pthread_mutex_lock(&victim->queue.lock);
+    stolen = (victim->queue.count + 1) / 2;
+    first = stolen ? take(&victim->queue, stolen) : NULL;
+    pthread_mutex_unlock(&victim->queue.lock);
+
+    if (!first)
+      continue;
+
+    last = first;
+    for (nvm_task *task = first; task; task = task->next){
+      task->stats.stolen++;
+      last = task;
+    }
+
+    /* (the queues are never locked two at a time, so the thieves can't
+     * deadlock stealing from each other) */
+    if (stolen > 1){
+      pthread_mutex_lock(&worker->queue.lock);
+      append(&worker->queue, first->next, last, stolen - 1);
+      pthread_mutex_unlock(&worker->queue.lock);
+    }
+
+    first->next = NULL;
+    return first;
+  }
+
+  return NULL;
+  /* }}} */
+}
+/* }}} */
+
+/*
+ * name:        unpark
+ * description: puts the task the <waiter> is of back in the queue, once the
+ *              channel it waits for is ready
+ */
+static void unpark(nvm_waiter *waiter)
+{
+  nvm_task *task = (nvm_task *)waiter;
+
+  enqueue(task->worker, task);
+}
+
+/*
+ * name:        run_slice
+ * description: runs the <task> on the <worker> till it's out of fuel, and
+ *              puts it back in the queue, or till it's done
+ */
+static void run_slice(worker_t *worker, nvm_task *task)
+{
+  /* {{{ run_slice body */
+  nvm_sched *sched = worker->sched;
+  uint64_t start = now();
+  int status;
+
+  task->stats.wait_ns += start - task->queued_at;
+
+  nvm_set_fuel(task->vm, sched->slice);
+  status = task->started ? nvm_resume(task->vm) : nvm_blastoff(task->vm);
+  task->started = true;
+
+  task->stats.run_ns += now() - start;
+  task->stats.slices++;
+
+  if (status == NVM_BLOCKED){
+    task->stats.blocked++;
+    task->worker = worker;
+    /* (once it's parked, it's the other sides, which may have woken it up
+     * already) */
+    if (!nvm_channel_park(task->vm, &task->waiter))
+      enqueue(worker, task);
+    return;
+  }
+
+  if (status == NVM_OUT_OF_FUEL || status == NVM_YIELDED){
+    if (status == NVM_OUT_OF_FUEL)
+      task->stats.preempted++;
+    else
+      task->stats.yielded++;
+    enqueue(worker, task);
+    return;
+  }
+
+  pthread_mutex_lock(&sched->lock);
+  task->status = status;
+  task->done = true;
+  pthread_cond_broadcast(&sched->done);
+  pthread_mutex_unlock(&sched->lock);
+  /* }}} */
+}
+
+/*
+ * name:        work
+ * description: the workers thread: runs the tasks from its queue (or stolen
+ *              ones), or sleeps if there's none, till the scheduler stops
+ */
+static void *work(void *arg)
+{
+  /* {{{ work body */
+  worker_t *worker = arg;
+  nvm_sched *sched = worker->sched;
+
+  while (!__atomic_load_n(&sched->stopping, __ATOMIC_SEQ_CST)){
+    nvm_task *task = dequeue(worker);
+
+    if (!task)
+      task = steal(worker);
+
+    if (task){
+      __atomic_sub_fetch(&sched->queued, 1, __ATOMIC_SEQ_CST);
+      run_slice(worker, task);
+      continue;
+    }
+
+    pthread_mutex_lock(&sched->lock);
+    __atomic_add_fetch(&sched->sleeping, 1, __ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&sched->queued, __ATOMIC_SEQ_CST) && !sched->stopping)
+      pthread_cond_wait(&sched->wake, &sched->lock);
+    __atomic_sub_fetch(&sched->sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&sched->lock);
+  }
+
+  return NULL;
+  /* }}} */
+}
+
+nvm_sched *nvm_sched_init(unsigned threads, uint64_t slice)
+{
+  /* {{{ nvm_sched_init body */
+  nvm_sched *sched = malloc(sizeof(nvm_sched));
+
+  if (!sched)
+    return NULL;
+
+  if (!threads){
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+
+  sched->workers = malloc(threads * sizeof(worker_t));
+  if (!sched->workers){
+    free(sched);
+    return NULL;
+  }
+  sched->workers_count = threads;
+  sched->started = 0;
+  sched->slice = slice ? slice : NVM_SCHED_DEFAULT_SLICE;
+  sched->spawned = NULL;
+  sched->next_worker = 0;
+  sched->queued = 0;
+  sched->sleeping = 0;
+  sched->stopping = false;
+  pthread_mutex_init(&sched->lock, NULL);
+  pthread_cond_init(&sched->wake, NULL);
+  pthread_cond_init(&sched->done, NULL);
+
+  /* they're all there before any of them starts stealing */
+  for (unsigned i = 0; i < threads; i++){
+    worker_t *worker = &sched->workers[i];
+
+    worker->sched = sched;
+    worker->seed = 2463534242u + i;
+    worker->queue.head = NULL;
+    worker->queue.tail = NULL;
+    worker->queue.count = 0;
+    pthread_mutex_init(&worker->queue.lock, NULL);
+  }
+
+  for (; sched->started < threads; sched->started++){
+    if (pthread_create(&sched->workers[sched->started].thread, NULL, work, &sched->workers[sched->started])){
+      /* (the ones started so far are stopped) */
+      nvm_sched_destroy(sched);
+      return NULL;
+    }
+  }
+
+  return sched;
+  /* }}} */
+}
+
+void nvm_sched_destroy(nvm_sched *sched)
+{
+  /* {{{ nvm_sched_destroy body */
+  pthread_mutex_lock(&sched->lock);
+  __atomic_store_n(&sched->stopping, true, __ATOMIC_SEQ_CST);
+  pthread_cond_broadcast(&sched->wake);
+  pthread_mutex_unlock(&sched->lock);
+
+  for (unsigned i = 0; i < sched->started; i++)
+    pthread_join(sched->workers[i].thread, NULL);
+  for (unsigned i = 0; i < sched->workers_count; i++)
+    pthread_mutex_destroy(&sched->workers[i].queue.lock);
+
+  /* the queued ones are among them */
+  while (sched->spawned){
+    nvm_task *task = sched->spawned;
+    sched->spawned = task->next_spawned;
+    free(task);
+  }
+
+  pthread_cond_destroy(&sched->done);
+  pthread_cond_destroy(&sched->wake);
+  pthread_mutex_destroy(&sched->lock);
+  free(sched->workers);
+  free(sched);
+  /* }}} */
+}
+
+nvm_task *nvm_sched_spawn(nvm_sched *sched, nvm_t *vm)
+{
+  /* {{{ nvm_sched_spawn body */
+  nvm_task *task = calloc(1, sizeof(nvm_task));
+  unsigned worker;
+
+  if (!task)
+    return NULL;
+
+  task->vm = vm;
+  task->waiter.wake = unpark;
+
+  pthread_mutex_lock(&sched->lock);
+  task->next_spawned = sched->spawned;
+  if (sched->spawned)
+    sched->spawned->prev_spawned = task;
+  sched->spawned = task;
+  /* (the stealing evens it out, if they aren't all as long) */
+  worker = sched->next_worker++ % sched->workers_count;
+  pthread_mutex_unlock(&sched->lock);
+
+  enqueue(&sched->workers[worker], task);
+
+  return task;
+  /* }}} */
+}
+
+int nvm_sched_join(nvm_sched *sched, nvm_task *task, nvm_task_stats *stats)
+{
+  /* {{{ nvm_sched_join body */
+  int status;
+
+  pthread_mutex_lock(&sched->lock);
+  while (!task->done)
+    pthread_cond_wait(&sched->done, &sched->lock);
+
+  if (task->prev_spawned)
+    task->prev_spawned->next_spawned = task->next_spawned;
+  else
+    sched->spawned = task->next_spawned;
+  if (task->next_spawned)
+    task->next_spawned->prev_spawned = task->prev_spawned;
+  pthread_mutex_unlock(&sched->lock);
+
+  status = task->status;
+  if (stats)
+    *stats = task->stats;
+  free(task);
+
+  return status;
+  /* }}} */
+}
@@ -0,0 +1,98 @@
+/*
+ *
+ * sched.h
+ *
+ * Created at:  10/19/2026 05:12:48 PM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * A scheduler that runs any number of VMs on a few threads, a slice of fuel at
+ * a time (see `nvm_set_fuel`).
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+#include "nvm.h"
+
+/* Fuel a VM runs with before it's the next ones turn, if not given */
+#define NVM_SCHED_DEFAULT_SLICE 1024
+
+/*
+ * NVM type for the scheduler (see sched.c).
+ */
+typedef struct _nvm_sched nvm_sched;
+
+/*
+ * NVM type for a VM being run by the scheduler.
+ */
+typedef struct _nvm_task nvm_task;
+
+/*
+ * NVM type for the statistics of a task.
+ */
+typedef struct {
+  /* number of the slices it ran */
+  uint64_t slices;
+  /* how many of them ended with it running out of fuel, and how many with it
+   * YIELDing to the host (giving the rest of the slice away) */
+  uint64_t preempted;
+  uint64_t yielded;
+  /* how many ended with it blocked on a channel (and parked on it) */
+  uint64_t blocked;
+  /* number of times it was stolen by another thread */
+  uint64_t stolen;
+  /* nanoseconds it ran for, and waited for its turns for */
+  uint64_t run_ns;
+  uint64_t wait_ns;
+} nvm_task_stats;
+
+/*
+ * name:        nvm_sched_init
+ * description: starts a scheduler with <threads> threads (as many as there are
+ *              CPUs, if 0), which run the VMs <slice> calls at a time
+ *              (NVM_SCHED_DEFAULT_SLICE, if 0)
+ * return:      the scheduler, or NULL if it couldn't be started
+ */
+nvm_sched *nvm_sched_init(unsigned threads, uint64_t slice);
+
+/*
+ * name:        nvm_sched_destroy
+ * description: stops the threads (once they're done with the slices they're
+ *              in the middle of) and frees the scheduler, and the tasks that
+ *              weren't joined (their VMs stay the way they are, and the
+ *              channels they're parked on can't be used any more)
+ */
+void nvm_sched_destroy(nvm_sched *sched);
+
+/*
+ * name:        nvm_sched_spawn
+ * description: starts the <vm> off (validated, and with its host functions
+ *              registered) on one of the threads; it's the schedulers until
+ *              it's joined, a YIELD to the host just gives its turn away, and
+ *              when it's blocked on a channel, it's parked on it till it can
+ *              go on
+ * return:      the task, or NULL if there was no memory for it
+ */
+nvm_task *nvm_sched_spawn(nvm_sched *sched, nvm_t *vm);
+
+/*
+ * name:        nvm_sched_join
+ * description: waits until the <task> is done, fills the <stats> (if not
+ *              NULL) and frees the task; not to be called from the host
+ *              functions of the tasks (their thread would wait with them)
+ * return:      what the VM ended with (see `nvm_blastoff`), NVM_DONE,
+ *              NVM_ERROR (a runtime error of one VM doesn't touch the others)
+ *              or NVM_AWAITING (it's left for the caller to complete, the
+ *              scheduler has no loop to wait on)
+ */
+int nvm_sched_join(nvm_sched *sched, nvm_task *task, nvm_task_stats *stats);
+
+#endif /* SCHED_H */
@@ -0,0 +1,252 @@
+/*
+ *
+ * str.c
+ *
+ * Created at:  10/19/2026 01:12:37 AM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * Strings.
+ *
+ * A STRING of at most NVM_SHORT_STRING bytes is kept right in the value, so
+ * the short ones never touch the heap. The longer ones are nvm_strings on the
+ * garbage collected heap, and the value knows the length of both kinds.
+ *
+ * The concatenation leaves room in the nvm_strings it makes, so that `s = s +
+ * x` over and over appends to the same one, copying every char just once (or
+ * a few times, when it runs out of room and moves to one twice as big), and
+ * the chars are always in one piece for whatever reads them.
+ *
+ * The interned strings are hash-consed in an open addressing table: there's
+ * only ever one of the same chars. They're the long string constants and the
+ * names of the variables and functions, which there's only as many of as the
+ * bytecode has, so the table keeps them alive until the VM is destroyed.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvm.h"
+#include "str.h"
+#include "gc.h"
+
+/* Initial number of slots of the interned strings table (a power of two) */
+#define INITIAL_INTERNED_SIZE 64
+
+struct _nvm_strings {
+  /* the interned strings, NULL for the empty slots */
+  nvm_string **slots;
+  /* number of the strings */
+  size_t count;
+  /* number of the slots */
+  size_t size;
+};
+
+/*
+ * name:        hash
+ * description: FNV-1a of the chars
+ */
+static uint32_t hash(const char *chars, uint32_t length)
+{
+  uint32_t h = 2166136261u;
+
+  for (uint32_t i = 0; i < length; i++){
+    h ^= (unsigned char)chars[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+/*
+ * name:        new_string
+ * description: allocates a string of <length> chars (left for the caller to
+ *              fill, except for the NUL) with room for <capacity> of them, in
+ *              the nursery, or straight in the old generation if <old>
+ */
+static nvm_string *new_string(nvm_t *vm, uint32_t length, uint32_t capacity, bool old)
+{
+  size_t size = sizeof(nvm_string) + capacity + 1;
+  nvm_string *s = old ? nvm_gc_alloc_old(vm, size, STRING) : nvm_gc_alloc(vm, size, STRING);
+
+  s->hash = 0;
+  s->length = length;
+  s->capacity = capacity;
+  s->chars[length] = '\0';
+
+  return s;
+}
+
+/*
+ * name:        grow
+ * description: doubles the table, rehashing the strings
+ */
+static void grow(nvm_t *vm)
+{
+  /* {{{ grow body */
+  nvm_strings *t = vm->strings;
+  size_t size = t->size ? t->size * 2 : INITIAL_INTERNED_SIZE;
+  nvm_string **slots = nvm_alloc(vm, size * sizeof(nvm_string *));
+
+  memset(slots, 0, size * sizeof(nvm_string *));
+
+  for (size_t i = 0; i < t->size; i++){
+    nvm_string *s = t->slots[i];
+    size_t j;
+
+    if (!s)
+      continue;
+    for (j = s->hash & (size - 1); slots[j]; j = (j + 1) & (size - 1))
+      ;
+    slots[j] = s;
+  }
+
+  if (t->slots)
+    vm->freeer(t->slots);
+  t->slots = slots;
+  t->size = size;
+  /* }}} */
+}
+
+nvm_string *nvm_str_intern(nvm_t *vm, const char *chars, uint32_t length)
+{
+  /* {{{ nvm_str_intern body */
+  uint32_t h = hash(chars, length);
+  nvm_strings *t = vm->strings;
+  nvm_string *s;
+  size_t i;
+
+  if (!t){
+    t = vm->strings = nvm_alloc(vm, sizeof(nvm_strings));
+    memset(t, 0, sizeof(nvm_strings));
+  }
+  /* keep it at most half full */
+  if ((t->count + 1) * 2 > t->size)
+    grow(vm);
+
+  for (i = h & (t->size - 1); (s = t->slots[i]) != NULL; i = (i + 1) & (t->size - 1))
+    if (s->hash == h && s->length == length && !memcmp(s->chars, chars, length))
+      return s;
+
+  /* it's there for good, so there's no point in it going through the
+   * nursery */
+  s = new_string(vm, length, length, true);
+  memcpy(s->chars, chars, length);
+  s->hash = h;
+  t->slots[i] = s;
+  t->count++;
+
+  return s;
+  /* }}} */
+}
+
+void nvm_str_const(nvm_t *vm, nvm_value *value, const char *chars, uint32_t length)
+{
+  value->type = STRING;
+  value->length = length;
+
+  if (length <= NVM_SHORT_STRING)
+    memcpy(value->as.chars, chars, length);
+  else
+    value->as.ptr = nvm_str_intern(vm, chars, length);
+}
+
+void nvm_str_new(nvm_t *vm, nvm_value *value, const char *chars, uint32_t length)
+{
+  nvm_string *s;
+
+  if (length <= NVM_SHORT_STRING){
+    nvm_str_const(vm, value, chars, length);
+    return;
+  }
+
+  s = new_string(vm, length, length, false);
+  memcpy(s->chars, chars, length);
+  value->type = STRING;
+  value->length = length;
+  value->as.ptr = s;
+}
+
+bool nvm_str_concat(nvm_t *vm, nvm_value *a, const nvm_value *b)
+{
+  /* {{{ nvm_str_concat body */
+  uint64_t length = (uint64_t)a->length + b->length;
+
+  if (length > UINT32_MAX)
+    return false;
+
+  if (length <= NVM_SHORT_STRING){
+    /* both were short too */
+    memcpy(a->as.chars + a->length, b->as.chars, b->length);
+    a->length = length;
+    return true;
+  }
+
+  nvm_string *s = a->length > NVM_SHORT_STRING ? a->as.ptr : NULL;
+
+  /* <a> sees the whole string, and there's room for <b> after it, so it
+   * just goes there (no one else sees those chars) */
+  if (s && s->length == a->length && s->capacity - s->length >= b->length){
+    memcpy(s->chars + s->length, nvm_str_chars(b), b->length);
+    s->length = length;
+    a->length = length;
+    return true;
+  }
+
+  /* leave room to append to it (but not to the strings that aren't the
+   * result of a concatenation themselves, not everything grows) */
+  uint64_t capacity = s && !s->hash ? length * 2 : length;
+  if (capacity > UINT32_MAX)
+    capacity = UINT32_MAX;
+
+  /* the allocation doesn't collect, so <a> and <b> stay where they are */
+  s = new_string(vm, length, capacity, false);
+  memcpy(s->chars, nvm_str_chars(a), a->length);
+  memcpy(s->chars + a->length, nvm_str_chars(b), b->length);
+
+  a->length = length;
+  a->as.ptr = s;
+
+  return true;
+  /* }}} */
+}
+
+void nvm_str_visit_interned(nvm_t *vm, void (*visit)(nvm_t *, nvm_value *))
+{
+  /* {{{ nvm_str_visit_interned body */
+  nvm_strings *t = vm->strings;
+  nvm_value value;
+
+  if (!t)
+    return;
+
+  for (size_t i = 0; i < t->size; i++){
+    if (!t->slots[i])
+      continue;
+    value.type = STRING;
+    /* (it has to look like a long one, so it's taken for what's on the
+     * heap) */
+    value.length = t->slots[i]->length > NVM_SHORT_STRING ? t->slots[i]->length : NVM_SHORT_STRING + 1;
+    value.as.ptr = t->slots[i];
+    visit(vm, &value);
+  }
+  /* }}} */
+}
+
+void nvm_str_free_all(nvm_t *vm)
+{
+  if (!vm->strings)
+    return;
+
+  if (vm->strings->slots)
+    vm->freeer(vm->strings->slots);
+  vm->freeer(vm->strings);
+  vm->strings = NULL;
+}
@@ -0,0 +1,100 @@
+/*
+ *
+ * str.h
+ *
+ * Created at:  10/19/2026 01:12:37 AM
+ *
+ * Author:  Szymon Urbaś <szymon.urbas@aol.com>
+ *
+ * License: the MIT license
+ *
+ */
+
+/*
+ * The STRING values, and the interned strings the names are made of.
+ */
+
+#ifndef STR_H
+#define STR_H
+
+#include <stdint.h>
+
+#include "nvm.h"
+
+/*
+ * The STRINGs of more than NVM_SHORT_STRING bytes (it's what the values' `ptr`
+ * points to). It's an append buffer: the values sharing it see the first
+ * `length` chars of it (their own length), and appending to the value that
+ * sees all of them just fills the room that's left (see `nvm_str_concat`).
+ * What a value sees never changes.
+ */
+typedef struct {
+  /* hash of the chars (only the interned ones have it) */
+  uint32_t hash;
+  /* number of the chars so far */
+  uint32_t length;
+  /* number of the chars there's room for */
+  uint32_t capacity;
+  /* the chars (the interned ones are NUL terminated, which the C code can
+   * rely on, the others aren't) */
+  char chars[];
+} nvm_string;
+
+/*
+ * name:        nvm_str_chars
+ * description: returns the chars of the STRING <value> (which aren't NUL
+ *              terminated, only the first <value>->length of them are its)
+ */
+static inline const char *nvm_str_chars(const nvm_value *value)
+{
+  return value->length <= NVM_SHORT_STRING ? value->as.chars : ((const nvm_string *)value->as.ptr)->chars;
+}
+
+/*
+ * name:        nvm_str_intern
+ * description: returns THE string of those <length> <chars>, so the same ones
+ *              can be told apart by just comparing the pointers; it stays
+ *              until the VM is destroyed
+ */
+nvm_string *nvm_str_intern(nvm_t *virtual_machine, const char *chars, uint32_t length);
+
+/*
+ * name:        nvm_str_const
+ * description: makes <value> the STRING of those <length> <chars> (the long
+ *              ones are interned, so loading a constant allocates nothing)
+ */
+void nvm_str_const(nvm_t *virtual_machine, nvm_value *value, const char *chars, uint32_t length);
+
+/*
+ * name:        nvm_str_new
+ * description: the same as `nvm_str_const`, but the long ones are just
+ *              allocated (on the garbage collected heap, see `nvm_gc_alloc`),
+ *              for the chars that don't come from the bytecode
+ */
+void nvm_str_new(nvm_t *virtual_machine, nvm_value *value, const char *chars, uint32_t length);
+
+/*
+ * name:        nvm_str_concat
+ * description: writes the concatenation of the STRINGs <a> and <b> over <a>;
+ *              appending to the same string over and over takes linear time
+ *              overall
+ * return:      whether it fit (a STRING can't be longer than UINT32_MAX
+ *              bytes, <a> is left alone if it would be)
+ */
+bool nvm_str_concat(nvm_t *virtual_machine, nvm_value *a, const nvm_value *b);
+
+/*
+ * name:        nvm_str_visit_interned
+ * description: calls <visit> with every interned string (for the garbage
+ *              collector)
+ */
+void nvm_str_visit_interned(nvm_t *virtual_machine, void (*visit)(nvm_t *, nvm_value *));
+
+/*
+ * name:        nvm_str_free_all
+ * description: frees the table of the interned strings (the strings are on
+ *              the heap, which frees them itself)
+ */
+void nvm_str_free_all(nvm_t *virtual_machine);
+
+#endif /* STR_H */